@@ -12,6 +12,7 @@
 #include <cstring>
 #include <vector>
 #include <climits>
+#include "rle.h"
 
 //arbitrary size to accept most cases of input
 int const BUFFER_SIZE = INT_MAX;
@@ -36,19 +37,21 @@ int main(int argc, char* argv[]) {
             return 1;
         }
 
+        //put all of current opened file into a buffer and then append it to another string, so an entry
+        //split between two reads is still decoded whole
+        std::string zipped;
         while ((stringRead = read(zipFile, buffer.data(), BUFFER_SIZE)) > 0) {
-            //process 5 bytes at a time
-            for (size_t i = 0; i < stringRead; i += 5) {
-                //set runLength to the first 4 chars and character as the 5th char
-                uint32_t runLength = buffer[i];
-                uint8_t character = buffer[i + 4];
-                
-                //write character runLength amount of times
-                for (uint32_t j = 0; j < runLength; ++j) {
-                    write(1, &character, sizeof(character));
-                }
-            }
+            zipped.append(buffer.data(), stringRead);
         }
+        close(zipFile);
+
+        //expand the 5-byte entries and write the characters out all at once
+        std::string unzipped;
+        if (!rleDecompress(zipped.data(), zipped.size(), unzipped)) {
+            write(1, "munzip: invalid file\n", 21);
+            return 1;
+        }
+        write(1, unzipped.data(), unzipped.size());
     }
     return 0;
 }
\ No newline at end of file
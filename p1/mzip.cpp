@@ -7,6 +7,7 @@
 #include <cstdint>
 #include <vector>
 #include <climits>
+#include "rle.h"
 
 //arbitrary size to accept most cases of input
 int const BUFFER_SIZE = INT_MAX;
@@ -61,30 +62,8 @@ void writeToZip(int file, const std::vector<char> content) {
         return;
     }
 
-    char targetChar = content[0];
-    int count = 0;
-
-    //iterate through the vector
-    for (size_t i = 0; i < content.size(); i++) {
-        //if the character is the same as the current, increment size
-        if (content[i] == targetChar) {
-            count++;
-        //if the character is not the same as the current, write size and character into stdout
-        //then set the target character as the current and set size = 1
-        } else {
-            //pretty much a precautionary condition to make sure the size is not 0
-            if (count > 0) {
-                write(file, (char*)&count, sizeof(count));
-                write(file, (char*)&targetChar, sizeof(targetChar));
-            }
-            targetChar = content[i];
-            count = 1;
-        }
-    }
-
-    //write the last count and character to the destination file
-    if (count > 0) {
-        write(file, (char*)&count, sizeof(count));
-        write(file, (char*)&targetChar, sizeof(targetChar));
-    }
+    //the run-length encoding itself is shared with munzip and p4
+    std::string zipped;
+    rleCompress(content.data(), content.size(), zipped);
+    write(file, zipped.data(), zipped.size());
 }
\ No newline at end of file
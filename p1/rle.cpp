@@ -0,0 +1,52 @@
+//Bryan Kim
+//rle.cpp
+//Run-length encoding shared by mzip, munzip and p4
+
+#include "rle.h"
+
+//runs are split so their length fits the 4 bytes mzip has always written (a signed int)
+uint32_t const MAX_RUN = INT32_MAX;
+
+bool rleCompress(const char* data, size_t size, std::string& output, size_t limit) {
+    size_t start = output.size();
+    size_t i = 0;
+
+    //iterate through the data a run at a time
+    while (i < size) {
+        char targetChar = data[i];
+        uint32_t count = 1;
+        while (i + count < size && data[i + count] == targetChar && count < MAX_RUN) {
+            count++;
+        }
+        i += count;
+
+        //stop as soon as the entries outgrow the limit
+        if (output.size() - start + RLE_ENTRY_SIZE > limit) {
+            return false;
+        }
+        char entry[RLE_ENTRY_SIZE] = { (char) count, (char) (count >> 8), (char) (count >> 16),
+                                       (char) (count >> 24), targetChar };
+        output.append(entry, RLE_ENTRY_SIZE);
+    }
+    return true;
+}
+
+bool rleDecompress(const char* data, size_t size, std::string& output, size_t limit) {
+    //a partial entry means the input was cut short or isn't RLE at all
+    if (size % RLE_ENTRY_SIZE != 0) {
+        return false;
+    }
+    size_t start = output.size();
+
+    //process 5 bytes at a time
+    for (size_t i = 0; i < size; i += RLE_ENTRY_SIZE) {
+        //the run length is all of the first 4 bytes, and the character is the 5th
+        const uint8_t* entry = (const uint8_t*) data + i;
+        uint32_t runLength = entry[0] | (entry[1] << 8) | (entry[2] << 16) | ((uint32_t) entry[3] << 24);
+        if (runLength > limit - (output.size() - start)) {
+            return false;
+        }
+        output.append(runLength, (char) entry[4]);
+    }
+    return true;
+}
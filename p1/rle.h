@@ -0,0 +1,26 @@
+//Bryan Kim
+//rle.h
+//Run-length encoding shared by mzip, munzip and p4
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+//each entry is a 4-byte run length (least significant byte first) followed by the character
+size_t const RLE_ENTRY_SIZE = 5;
+
+// desc : Compresses data into 5-byte entries
+//        (4 bytes describing run length, 1 byte for the character)
+// pre  : none
+// post : appends the entries to output. returns false if they would take
+//        more than limit bytes, leaving output as far as it got
+bool rleCompress(const char* data, size_t size, std::string& output, size_t limit = SIZE_MAX);
+
+// desc : Expands 5-byte entries back into the data they describe
+// pre  : none
+// post : appends the data to output. returns false if the input is not
+//        made of whole entries or would expand to more than limit bytes,
+//        leaving output as far as it got
+bool rleDecompress(const char* data, size_t size, std::string& output, size_t limit = SIZE_MAX);
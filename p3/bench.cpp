@@ -0,0 +1,394 @@
+//bench.cpp
+//This code benchmarks the Game of Life kernels across board sizes, patterns and thread counts
+
+#include "grid.h"
+#include "rule.h"
+#include "kernel.h"
+#include "stepper.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+//settings for a benchmark run, filled in from the command line
+struct BenchOptions {
+    std::vector<int> sizes = {64, 256, 1024, 4096, 16384};
+    std::vector<std::string> patterns = {"soup", "rpentomino", "acorn", "diehard"};
+    std::vector<std::string> kernels = {"fixed", "table", "blocked"};
+    int block_generations = 8;      //generations per pass for the blocked kernel
+    std::vector<int> threads;       //empty for 1, 2, 4, ... up to the hardware thread count
+    std::string rule = "B3/S23";
+    double min_time = 0.5;          //seconds to time each case for
+    int min_generations = 5;
+    int max_generations = 10000;
+    std::string csv_path;           //empty to skip writing a csv file
+};
+
+//the measurements for one case
+struct BenchResult {
+    std::string name;
+    std::string pattern;
+    int size;
+    std::string kernel;
+    int threads;
+    long generations;
+    double cells_per_second;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    size_t memory_bytes;
+    double efficiency;              //speedup over one thread divided by threads, or -1 if unknown
+};
+
+//desc: parses the benchmark options
+//pre : none
+//post: -returns false if an argument is malformed or unrecognized
+bool parse_bench_options(int argc, char *argv[], BenchOptions *options);
+
+//desc: fills a grid with the named pattern. "soup" is a random 50% fill, the others are
+//      methuselahs placed at the center of an otherwise empty grid
+//pre : -the grid is empty
+//post: -returns false if the pattern is not known
+bool seed_pattern(Grid& grid, std::string pattern, unsigned seed);
+
+//desc: times one case, stepping until both the minimum time and minimum generations are reached. with a
+//      block kernel, each pass advances block_generations and its time is spread over those generations
+//pre : -the grid holds the starting pattern
+//      -exactly one of kernel and block is set
+//post: -returns the measurements, with efficiency left for the caller to fill in
+BenchResult run_case(Grid& start, StepFunction kernel, BlockFunction block, const Rule& rule, int threads,
+                     const BenchOptions& options);
+
+//desc: returns the value at the input fraction (0-1) of a sorted list of latencies
+//pre : -latencies is sorted and not empty
+//post: none
+double percentile(const std::vector<double>& latencies, double fraction);
+
+//desc: formats a count of nanoseconds, bytes or cells per second for display
+//pre : none
+//post: none
+std::string format_time(double ns);
+std::string format_bytes(double bytes);
+std::string format_rate(double rate);
+
+//desc: runs every combination of size, pattern, kernel and thread count, printing a line per case
+//pre : none
+//post: -returns 0 on success
+int main(int argc, char *argv[]) {
+    BenchOptions options;
+    if (!parse_bench_options(argc, argv, &options)) {
+        std::cerr << "Usage:\np3_bench [--sizes 64,256,...] [--max-size <n>] [--patterns soup,acorn,...]\n"
+                  << "   [--kernels fixed,table,blocked] [--block <generations>] [--threads 1,2,...]\n"
+                  << "   [--rule B3/S23] [--min-time <seconds>] [--csv <file>]\n";
+        return 1;
+    }
+
+    Rule rule;
+    Rule::parse(options.rule, rule);
+
+    //one thread first, so each case has a baseline for parallel efficiency
+    if (options.threads.empty()) {
+        int hardware = std::max(1u, std::thread::hardware_concurrency());
+        for (int count = 1; count < hardware; count *= 2) {
+            options.threads.push_back(count);
+        }
+        options.threads.push_back(hardware);
+    }
+    std::sort(options.threads.begin(), options.threads.end());
+
+    std::printf("Rule %s, %u hardware threads\n", rule.to_string().c_str(), std::thread::hardware_concurrency());
+    std::printf("%-48s %10s %10s %10s %12s %10s %6s\n", "Benchmark", "p50", "p90", "p99", "Cells/s", "Memory", "Eff");
+    std::printf("%s\n", std::string(112, '-').c_str());
+
+    std::vector<BenchResult> results;
+    for (int size : options.sizes) {
+        for (std::string& pattern : options.patterns) {
+            Grid start(size, size);
+            if (!seed_pattern(start, pattern, 1)) {
+                std::cerr << "Unknown pattern '" << pattern << "'\n";
+                return 1;
+            }
+            for (std::string& kernel_choice : options.kernels) {
+                StepFunction kernel = nullptr;
+                BlockFunction block = nullptr;
+                std::string kernel_label;
+                if (kernel_choice == "fixed") {
+                    kernel = select_kernel(rule);
+                    kernel_label = kernel_name(rule);
+                } else if (kernel_choice == "table") {
+                    kernel = table_kernel();
+                    kernel_label = "table";
+                } else if (kernel_choice == "blocked") {
+                    block = select_block_kernel(rule);
+                    kernel_label = kernel_name(rule) + "/block:" + std::to_string(options.block_generations);
+                } else {
+                    std::cerr << "Unknown kernel '" << kernel_choice << "'\n";
+                    return 1;
+                }
+
+                double baseline = -1;
+                for (int threads : options.threads) {
+                    BenchResult result = run_case(start, kernel, block, rule, threads, options);
+                    result.pattern = pattern;
+                    result.size = size;
+                    result.kernel = kernel_label;
+                    result.name = "BM_Step/" + pattern + "/" + std::to_string(size) + "/" + kernel_label
+                                + "/threads:" + std::to_string(threads);
+                    if (threads == 1) {
+                        baseline = result.cells_per_second;
+                    }
+                    result.efficiency = (baseline > 0) ? result.cells_per_second / baseline / threads : -1;
+
+                    std::string efficiency = (result.efficiency < 0) ? "-"
+                                           : std::to_string((int) (result.efficiency * 100 + 0.5)) + "%";
+                    std::printf("%-48s %10s %10s %10s %12s %10s %6s\n", result.name.c_str(),
+                                format_time(result.p50_ns).c_str(), format_time(result.p90_ns).c_str(),
+                                format_time(result.p99_ns).c_str(), format_rate(result.cells_per_second).c_str(),
+                                format_bytes(result.memory_bytes).c_str(), efficiency.c_str());
+                    std::fflush(stdout);
+                    results.push_back(result);
+                }
+            }
+        }
+    }
+
+    if (!options.csv_path.empty()) {
+        std::ofstream csv(options.csv_path);
+        csv << "name,pattern,size,kernel,threads,generations,cells_per_second,p50_ns,p90_ns,p99_ns,memory_bytes,efficiency\n";
+        for (BenchResult& r : results) {
+            csv << r.name << ',' << r.pattern << ',' << r.size << ',' << r.kernel << ',' << r.threads << ','
+                << r.generations << ',' << r.cells_per_second << ',' << r.p50_ns << ',' << r.p90_ns << ','
+                << r.p99_ns << ',' << r.memory_bytes << ',' << r.efficiency << '\n';
+        }
+        if (!csv) {
+            std::cerr << "Failed to write " << options.csv_path << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+//desc: splits a comma separated list
+//pre : none
+//post: none
+static std::vector<std::string> split_list(std::string text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+bool parse_bench_options(int argc, char *argv[], BenchOptions *options) {
+    int max_size = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        //every option takes exactly one value
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (option == "--sizes" || option == "--threads") {
+            std::vector<int>& list = (option == "--sizes") ? options->sizes : options->threads;
+            list.clear();
+            for (std::string& item : split_list(value)) {
+                int number = atoi(item.c_str());
+                if (number <= 0) {
+                    return false;
+                }
+                list.push_back(number);
+            }
+        } else if (option == "--max-size") {
+            max_size = atoi(value.c_str());
+            if (max_size <= 0) {
+                return false;
+            }
+        } else if (option == "--patterns") {
+            options->patterns = split_list(value);
+        } else if (option == "--block") {
+            options->block_generations = atoi(value.c_str());
+            if (options->block_generations <= 0) {
+                return false;
+            }
+        } else if (option == "--kernels") {
+            options->kernels = split_list(value);
+        } else if (option == "--rule") {
+            Rule rule;
+            if (!Rule::parse(value, rule)) {
+                return false;
+            }
+            options->rule = value;
+        } else if (option == "--min-time") {
+            options->min_time = atof(value.c_str());
+        } else if (option == "--csv") {
+            options->csv_path = value;
+        } else {
+            return false;
+        }
+    }
+    if (max_size > 0) {
+        std::erase_if(options->sizes, [&](int size) { return size > max_size; });
+    }
+    return true;
+}
+
+
+bool seed_pattern(Grid& grid, std::string pattern, unsigned seed) {
+    if (pattern == "soup") {
+        std::mt19937_64 random(seed);
+        uint64_t bits = 0;
+        int left = 0;
+        for (int y = 0; y < grid.get_height(); y++) {
+            char *row = grid.row(y);
+            for (int x = 0; x < grid.get_width(); x++) {
+                if (left == 0) {
+                    bits = random();
+                    left = 64;
+                }
+                row[x] = (bits & 1) ? '#' : ' ';
+                bits >>= 1;
+                left--;
+            }
+        }
+        return true;
+    }
+
+    //methuselahs, as (x,y) offsets of their live cells
+    std::vector<std::pair<int,int>> cells;
+    if (pattern == "rpentomino") {
+        cells = {{1,0}, {2,0}, {0,1}, {1,1}, {1,2}};
+    } else if (pattern == "acorn") {
+        cells = {{1,0}, {3,1}, {0,2}, {1,2}, {4,2}, {5,2}, {6,2}};
+    } else if (pattern == "diehard") {
+        cells = {{6,0}, {0,1}, {1,1}, {1,2}, {5,2}, {6,2}, {7,2}};
+    } else {
+        return false;
+    }
+    int cx = grid.get_width() / 2 - 4;
+    int cy = grid.get_height() / 2 - 1;
+    for (auto& cell : cells) {
+        if (grid.exists(cx + cell.first, cy + cell.second)) {
+            grid.set_tile(cx + cell.first, cy + cell.second, true);
+        }
+    }
+    return true;
+}
+
+
+BenchResult run_case(Grid& start, StepFunction kernel, BlockFunction block, const Rule& rule, int threads,
+                     const BenchOptions& options) {
+    typedef std::chrono::steady_clock clock;
+    int width = start.get_width();
+    int height = start.get_height();
+    Grid *current = new Grid(width, height);
+    Grid *next = new Grid(width, height);
+    current->copy_from(start);
+    Stepper stepper(threads);
+    int generations = (block != nullptr) ? options.block_generations : 1;
+    auto step = [&]() {
+        if (block != nullptr) {
+            stepper.step(block, *current, *next, rule, generations);
+        } else {
+            stepper.step(kernel, *current, *next, rule);
+        }
+    };
+
+    //one untimed pass to fault in pages and wake the workers
+    step();
+    std::swap(current, next);
+
+    std::vector<double> latencies;
+    clock::time_point began = clock::now();
+    double elapsed = 0;
+    while ((elapsed < options.min_time || (int) latencies.size() < options.min_generations)
+           && (int) latencies.size() < options.max_generations) {
+        clock::time_point before = clock::now();
+        step();
+        clock::time_point after = clock::now();
+        std::swap(current, next);
+        double latency = std::chrono::duration<double, std::nano>(after - before).count() / generations;
+        for (int i = 0; i < generations; i++) {
+            latencies.push_back(latency);
+        }
+        elapsed = std::chrono::duration<double>(after - began).count();
+    }
+    delete current;
+    delete next;
+
+    double total_ns = 0;
+    for (double latency : latencies) {
+        total_ns += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    BenchResult result;
+    result.threads = threads;
+    result.generations = latencies.size();
+    result.cells_per_second = (double) width * height * latencies.size() / (total_ns / 1e9);
+    result.p50_ns = percentile(latencies, 0.50);
+    result.p90_ns = percentile(latencies, 0.90);
+    result.p99_ns = percentile(latencies, 0.99);
+    //the two grids dominate; each row carries a trailing newline
+    result.memory_bytes = 2 * (size_t) (width + 1) * height;
+    result.efficiency = -1;
+    return result;
+}
+
+
+double percentile(const std::vector<double>& latencies, double fraction) {
+    size_t index = (size_t) (fraction * (latencies.size() - 1) + 0.5);
+    return latencies[index];
+}
+
+
+std::string format_time(double ns) {
+    char text[32];
+    if (ns < 1e3) {
+        std::snprintf(text, sizeof(text), "%.0f ns", ns);
+    } else if (ns < 1e6) {
+        std::snprintf(text, sizeof(text), "%.1f us", ns / 1e3);
+    } else if (ns < 1e9) {
+        std::snprintf(text, sizeof(text), "%.2f ms", ns / 1e6);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f s", ns / 1e9);
+    }
+    return text;
+}
+
+
+std::string format_bytes(double bytes) {
+    char text[32];
+    if (bytes < 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.1f KiB", bytes / 1024);
+    } else if (bytes < 1024.0 * 1024 * 1024) {
+        std::snprintf(text, sizeof(text), "%.1f MiB", bytes / (1024 * 1024));
+    } else {
+        std::snprintf(text, sizeof(text), "%.2f GiB", bytes / (1024.0 * 1024 * 1024));
+    }
+    return text;
+}
+
+
+std::string format_rate(double rate) {
+    char text[32];
+    if (rate < 1e6) {
+        std::snprintf(text, sizeof(text), "%.1fk", rate / 1e3);
+    } else if (rate < 1e9) {
+        std::snprintf(text, sizeof(text), "%.1fM", rate / 1e6);
+    } else {
+        std::snprintf(text, sizeof(text), "%.2fG", rate / 1e9);
+    }
+    return text;
+}
@@ -0,0 +1,230 @@
+#include "checkpoint.h"
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <climits>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char     CHECKPOINT_MAGIC[4] = { 'P', '3', 'C', 'K' };
+static const uint32_t CHECKPOINT_VERSION  = 1;
+
+// Returns the number of bytes a packed row takes up
+static size_t packed_row_bytes(int width){
+    return (width + 7) / 8;
+}
+
+// Writes all of data to fd, looping over short writes.
+// Returns false on error.
+static bool write_all(int fd, const void *data, size_t length){
+    const char *bytes = (const char *) data;
+    while( length > 0 ){
+        ssize_t written = write(fd, bytes, length);
+        if( written < 0 ){
+            if( errno == EINTR ){
+                continue;
+            }
+            return false;
+        }
+        bytes  += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Writes a checkpoint of the grid to the input path,
+// replacing any previous file atomically. Throws a runtime
+// exception if the file cannot be written.
+void write_checkpoint(std::string path, Grid& grid, long generation, const Rule& rule){
+    int width  = grid.get_width();
+    int height = grid.get_height();
+
+    CheckpointHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    header.version    = CHECKPOINT_VERSION;
+    header.width      = width;
+    header.height     = height;
+    header.generation = generation;
+    std::string rule_text = rule.to_string();
+    std::strncpy(header.rule, rule_text.c_str(), sizeof(header.rule) - 1);
+
+    size_t row_bytes = packed_row_bytes(width);
+    std::vector<uint8_t> packed(row_bytes * height, 0);
+    for(int y=0; y<height; y++){
+        const char *row = grid.row(y);
+        uint8_t    *out = &packed[row_bytes * y];
+        for(int x=0; x<width; x++){
+            if( row[x] == '#' ){
+                out[x / 8] |= 1 << (x % 8);
+            }
+        }
+    }
+
+    // Write beside the destination, make it durable, then
+    // swap it in so a crash leaves either checkpoint whole
+    std::string temp_path = path + ".tmp";
+    int fd = open(temp_path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+    if( fd < 0 ){
+        throw std::runtime_error("Could not create checkpoint file '" + temp_path + "'.");
+    }
+    bool ok = write_all(fd, &header, sizeof(header))
+           && write_all(fd, packed.data(), packed.size())
+           && fsync(fd) == 0;
+    ok = (close(fd) == 0) && ok;
+    if( !ok || rename(temp_path.c_str(), path.c_str()) != 0 ){
+        unlink(temp_path.c_str());
+        throw std::runtime_error("Failed to write checkpoint file '" + path + "'.");
+    }
+}
+
+// Reports whether the input file starts with a checkpoint
+// header
+bool is_checkpoint(std::string path){
+    int fd = open(path.c_str(), O_RDONLY);
+    if( fd < 0 ){
+        return false;
+    }
+    char magic[4];
+    bool result = read(fd, magic, sizeof(magic)) == sizeof(magic)
+               && std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) == 0;
+    close(fd);
+    return result;
+}
+
+// Returns a newly allocated grid restored from a checkpoint,
+// storing its generation and rule. The file is mapped into
+// memory rather than read. Throws a runtime exception if the
+// file is not a valid checkpoint.
+Grid *restore_checkpoint(std::string path, long *generation, Rule *rule){
+    int fd = open(path.c_str(), O_RDONLY);
+    if( fd < 0 ){
+        throw std::runtime_error("Could not open checkpoint file '" + path + "'.");
+    }
+    struct stat info;
+    if( fstat(fd, &info) != 0 || info.st_size < (off_t) sizeof(CheckpointHeader) ){
+        close(fd);
+        throw std::runtime_error("Checkpoint file '" + path + "' is truncated.");
+    }
+    size_t size = info.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    if( mapping == MAP_FAILED ){
+        throw std::runtime_error("Could not map checkpoint file '" + path + "'.");
+    }
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    const CheckpointHeader *header = (const CheckpointHeader *) mapping;
+    const uint8_t *packed = (const uint8_t *) mapping + sizeof(CheckpointHeader);
+    std::string error;
+    Rule file_rule;
+    if( std::memcmp(header->magic, CHECKPOINT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != CHECKPOINT_VERSION ){
+        error = "is not a checkpoint";
+    } else if( header->width <= 0 || header->height <= 0 ||
+               ((long long) header->width + 1) * header->height > INT_MAX ){
+        error = "has invalid dimensions";
+    } else if( size - sizeof(CheckpointHeader) < packed_row_bytes(header->width) * header->height ){
+        error = "is truncated";
+    } else if( std::memchr(header->rule, '\0', sizeof(header->rule)) == nullptr ||
+               !Rule::parse(header->rule, file_rule) ){
+        error = "has an invalid rule";
+    }
+    if( !error.empty() ){
+        munmap(mapping, size);
+        throw std::runtime_error("Checkpoint file '" + path + "' " + error + ".");
+    }
+
+    int width  = header->width;
+    int height = header->height;
+    size_t row_bytes = packed_row_bytes(width);
+    Grid *grid = new Grid(width, height);
+    for(int y=0; y<height; y++){
+        const uint8_t *in  = packed + row_bytes * y;
+        char          *row = grid->row(y);
+        for(int x=0; x<width; x++){
+            row[x] = ((in[x / 8] >> (x % 8)) & 1) ? '#' : ' ';
+        }
+    }
+    *generation = header->generation;
+    *rule       = file_rule;
+    munmap(mapping, size);
+    return grid;
+}
+
+// Body of the writer thread
+void Checkpointer::write_loop(){
+    std::unique_lock lock(mut);
+    while( true ){
+        cond.wait(lock, [this]{ return pending || stopping; });
+        if( !pending ){
+            return;
+        }
+        // The snapshot is left alone while pending is set, so it
+        // can be written without holding the lock
+        lock.unlock();
+        try {
+            write_checkpoint(path, *snapshot, snapshot_generation, rule);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << "\n";
+        }
+        lock.lock();
+        pending = false;
+    }
+}
+
+// Copies the grid for the writer thread if the input
+// generation is due for a checkpoint. A checkpoint that
+// comes due while the previous one is still being written
+// is skipped rather than making the caller wait.
+void Checkpointer::on_generation(Grid& grid, long generation){
+    if( generation % interval != 0 ){
+        return;
+    }
+    std::unique_lock lock(mut, std::try_to_lock);
+    if( !lock.owns_lock() || pending ){
+        return;
+    }
+    snapshot->copy_from(grid);
+    snapshot_generation = generation;
+    pending = true;
+    cond.notify_one();
+}
+
+// Returns the number of generations between checkpoints
+long Checkpointer::get_interval(){
+    return interval;
+}
+
+// Constructor: Starts a writer thread that checkpoints a
+// grid of the input dimensions to path every 'interval'
+// generations
+// Precondition: interval must be positive
+Checkpointer::Checkpointer(std::string path, long interval, const Rule& rule, int w, int h)
+    : path(path)
+    , interval(interval)
+    , rule(rule)
+    , snapshot(new Grid(w,h))
+    , snapshot_generation(0)
+    , pending(false)
+    , stopping(false)
+{
+    writer = std::thread(&Checkpointer::write_loop, this);
+}
+
+// Destructor: finishes any pending checkpoint and stops
+// the writer thread
+Checkpointer::~Checkpointer(){
+    {
+        std::lock_guard lock(mut);
+        stopping = true;
+    }
+    cond.notify_one();
+    writer.join();
+    delete snapshot;
+}
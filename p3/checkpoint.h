@@ -0,0 +1,86 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "grid.h"
+#include "rule.h"
+
+// Binary checkpoint layout: this header, then one row after
+// another with tile x of each row stored in bit (x % 8) of
+// byte (x / 8), rows padded to whole bytes
+struct CheckpointHeader {
+    char     magic[4];      // "P3CK"
+    uint32_t version;
+    int32_t  width;
+    int32_t  height;
+    int64_t  generation;
+    char     rule[32];      // B/S notation, nul padded
+};
+
+///////////////////////////////////////////////////////////
+// Writes periodic checkpoints of a running simulation from
+// a background thread. The update thread only copies the
+// grid into a spare buffer; packing the tiles and writing
+// the file happen on the writer thread. Each file is
+// written beside its destination and renamed into place,
+// so a checkpoint is never seen half-written.
+///////////////////////////////////////////////////////////
+class Checkpointer {
+
+    std::string path;
+    long        interval;
+    Rule        rule;
+
+    // Copy of the generation waiting to be (or being) written
+    Grid       *snapshot;
+    long        snapshot_generation;
+
+    std::thread             writer;
+    std::mutex              mut;
+    std::condition_variable cond;
+    bool                    pending;
+    bool                    stopping;
+
+    // Body of the writer thread
+    void write_loop();
+
+    public:
+
+    // Copies the grid for the writer thread if the input
+    // generation is due for a checkpoint. A checkpoint that
+    // comes due while the previous one is still being written
+    // is skipped rather than making the caller wait.
+    void on_generation(Grid& grid, long generation);
+
+    // Returns the number of generations between checkpoints
+    long get_interval();
+
+    // Constructor: Starts a writer thread that checkpoints a
+    // grid of the input dimensions to path every 'interval'
+    // generations
+    // Precondition: interval must be positive
+    Checkpointer(std::string path, long interval, const Rule& rule, int w, int h);
+
+    // Destructor: finishes any pending checkpoint and stops
+    // the writer thread
+    ~Checkpointer();
+
+};
+
+// Writes a checkpoint of the grid to the input path,
+// replacing any previous file atomically. Throws a runtime
+// exception if the file cannot be written.
+void write_checkpoint(std::string path, Grid& grid, long generation, const Rule& rule);
+
+// Reports whether the input file starts with a checkpoint
+// header
+bool is_checkpoint(std::string path);
+
+// Returns a newly allocated grid restored from a checkpoint,
+// storing its generation and rule. The file is mapped into
+// memory rather than read. Throws a runtime exception if the
+// file is not a valid checkpoint.
+Grid *restore_checkpoint(std::string path, long *generation, Rule *rule);
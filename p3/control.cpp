@@ -0,0 +1,141 @@
+#include "control.h"
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Writes a reply line to a client, dropping it if the
+// client is not keeping up rather than stalling the channel
+static void send_reply(int fd, std::string reply){
+    reply += '\n';
+    send(fd, reply.data(), reply.size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+// Splits whatever is read from fd into lines and handles
+// each complete one, sending replies to reply_fd (or to
+// the terminal if it is negative). Returns false once fd
+// is closed or fails.
+bool ControlChannel::read_commands(int fd, std::string& partial, int reply_fd){
+    char buffer[4096];
+    ssize_t received = read(fd, buffer, sizeof(buffer));
+    if( received < 0 ){
+        return errno == EINTR || errno == EAGAIN;
+    }
+    if( received == 0 ){
+        return false;
+    }
+    partial.append(buffer, received);
+
+    size_t newline;
+    while( (newline = partial.find('\n')) != std::string::npos ){
+        std::string line = partial.substr(0, newline);
+        partial.erase(0, newline + 1);
+        if( !line.empty() && line.back() == '\r' ){
+            line.pop_back();
+        }
+        std::string reply = handler(line);
+        if( reply_fd >= 0 ){
+            send_reply(reply_fd, reply);
+        } else {
+            terminal_reply(reply);
+        }
+    }
+    return true;
+}
+
+// Waits up to timeout_ms for commands and handles those
+// that arrive
+void ControlChannel::poll_commands(int timeout_ms){
+    // stdin first, then the listening socket, then clients
+    std::vector<pollfd> fds;
+    if( watch_stdin ){
+        fds.push_back({ STDIN_FILENO, POLLIN, 0 });
+    }
+    if( listen_fd >= 0 ){
+        fds.push_back({ listen_fd, POLLIN, 0 });
+    }
+    for(Source& client : clients){
+        fds.push_back({ client.fd, POLLIN, 0 });
+    }
+    if( poll(fds.data(), fds.size(), timeout_ms) <= 0 ){
+        return;
+    }
+
+    size_t index = 0;
+    if( watch_stdin ){
+        if( fds[index].revents != 0 && !read_commands(STDIN_FILENO, stdin_partial, -1) ){
+            // Input was closed; the channel carries on without it
+            watch_stdin = false;
+        }
+        index++;
+    }
+    size_t polled_clients = clients.size();
+    if( listen_fd >= 0 ){
+        if( fds[index].revents & POLLIN ){
+            int client_fd = accept(listen_fd, nullptr, nullptr);
+            if( client_fd >= 0 ){
+                clients.push_back({ client_fd, "" });
+            }
+        }
+        index++;
+    }
+    // Clients accepted just now were not polled yet
+    for(size_t i=0; i<polled_clients; index++){
+        if( fds[index].revents != 0 && !read_commands(clients[i].fd, clients[i].partial, clients[i].fd) ){
+            close(clients[i].fd);
+            clients.erase(clients.begin() + i);
+            polled_clients--;
+        } else {
+            i++;
+        }
+    }
+}
+
+// Constructor: Watches stdin, and listens on a Unix socket
+// at socket_path unless it is empty. Throws a runtime
+// exception if the socket cannot be set up.
+ControlChannel::ControlChannel(std::string socket_path, Handler handler, TerminalReply terminal_reply)
+    : socket_path(socket_path)
+    , listen_fd(-1)
+    , watch_stdin(true)
+    , handler(handler)
+    , terminal_reply(terminal_reply)
+{
+    if( socket_path.empty() ){
+        return;
+    }
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if( socket_path.size() >= sizeof(address.sun_path) ){
+        throw std::runtime_error("Control socket path '" + socket_path + "' is too long.");
+    }
+    std::strcpy(address.sun_path, socket_path.c_str());
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if( listen_fd < 0 ){
+        throw std::runtime_error("Could not allocate control socket.");
+    }
+    // A socket file left behind by an earlier run would make
+    // binding fail
+    unlink(socket_path.c_str());
+    if( bind(listen_fd, (sockaddr *) &address, sizeof(address)) < 0 || listen(listen_fd, 8) < 0 ){
+        close(listen_fd);
+        throw std::runtime_error("Could not listen on control socket '" + socket_path + "'.");
+    }
+}
+
+// Destructor: disconnects the clients and removes the
+// socket file
+ControlChannel::~ControlChannel(){
+    for(Source& client : clients){
+        close(client.fd);
+    }
+    if( listen_fd >= 0 ){
+        close(listen_fd);
+        unlink(socket_path.c_str());
+    }
+}
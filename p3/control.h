@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+///////////////////////////////////////////////////////////
+// Reads line-based commands from the terminal and, if a
+// path is given, from clients of a local Unix socket,
+// without ever blocking on either. Each command is passed
+// to a handler and its reply is sent back to where the
+// command came from: to the client that sent it, or to a
+// separate function for the terminal (whose screen belongs
+// to the renderer).
+///////////////////////////////////////////////////////////
+class ControlChannel {
+
+    public:
+
+    // Returns the reply to a command line
+    typedef std::function<std::string(const std::string&)> Handler;
+
+    // Takes the reply to a command typed at the terminal
+    typedef std::function<void(const std::string&)> TerminalReply;
+
+    private:
+
+    // A connection and the part of a line read from it so far
+    struct Source {
+        int         fd;
+        std::string partial;
+    };
+
+    std::string         socket_path;
+    int                 listen_fd;
+    bool                watch_stdin;
+    std::string         stdin_partial;
+    std::vector<Source> clients;
+    Handler             handler;
+    TerminalReply       terminal_reply;
+
+    // Splits whatever is read from fd into lines and handles
+    // each complete one, sending replies to reply_fd (or to
+    // the terminal if it is negative). Returns false once fd
+    // is closed or fails.
+    bool read_commands(int fd, std::string& partial, int reply_fd);
+
+    public:
+
+    // Waits up to timeout_ms for commands and handles those
+    // that arrive
+    void poll_commands(int timeout_ms);
+
+    // Constructor: Watches stdin, and listens on a Unix socket
+    // at socket_path unless it is empty. Throws a runtime
+    // exception if the socket cannot be set up.
+    ControlChannel(std::string socket_path, Handler handler, TerminalReply terminal_reply);
+
+    // Destructor: disconnects the clients and removes the
+    // socket file
+    ~ControlChannel();
+
+};
@@ -0,0 +1,44 @@
+#include "cycle.h"
+
+// Records the hash of a generation. Returns true if the
+// same state was seen earlier within the history, after
+// which the period and settling generation are known.
+// Precondition: generations are recorded in order
+bool CycleDetector::record(uint64_t hash, long generation){
+    auto found = seen.find(hash);
+    if( found != seen.end() ){
+        // States are recorded from the start, so the first
+        // repeat found is the first generation of the cycle
+        period  = generation - found->second;
+        settled = found->second;
+        return true;
+    }
+
+    seen[hash] = generation;
+    order.push_back({hash, generation});
+    if( (int) order.size() > capacity ){
+        seen.erase(order.front().first);
+        order.pop_front();
+    }
+    return false;
+}
+
+// Returns the period of the detected cycle (1 for a still
+// life), or 0 if none has been detected
+long CycleDetector::get_period(){
+    return period;
+}
+
+// Returns the first generation of the detected cycle
+long CycleDetector::get_settled(){
+    return settled;
+}
+
+// Constructor: Creates a detector that remembers the
+// input number of generations
+// Precondition: history must be positive
+CycleDetector::CycleDetector(int history)
+    : capacity(history)
+    , period(0)
+    , settled(0)
+{}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+
+///////////////////////////////////////////////////////////
+// Detects when a simulation has settled into a still life
+// or a periodic cycle, from the hash of each generation.
+// Only the most recent generations are remembered, so
+// cycles longer than the history go unnoticed.
+///////////////////////////////////////////////////////////
+class CycleDetector {
+
+    int capacity;
+
+    // Hashes of recent generations, oldest first, and the
+    // generation each hash was last seen at
+    std::deque<std::pair<uint64_t,long>> order;
+    std::unordered_map<uint64_t,long>    seen;
+
+    long period;
+    long settled;
+
+    public:
+
+    // Records the hash of a generation. Returns true if the
+    // same state was seen earlier within the history, after
+    // which the period and settling generation are known.
+    // Precondition: generations are recorded in order
+    bool record(uint64_t hash, long generation);
+
+    // Returns the period of the detected cycle (1 for a still
+    // life), or 0 if none has been detected
+    long get_period();
+
+    // Returns the first generation of the detected cycle
+    long get_settled();
+
+    // Constructor: Creates a detector that remembers the
+    // input number of generations
+    // Precondition: history must be positive
+    CycleDetector(int history);
+
+};
@@ -0,0 +1,509 @@
+#include "distributed.h"
+#include "kernel.h"
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <endian.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/tcp.h>
+
+// What the coordinator tells a worker before sending its
+// strip. Integers are in network byte order.
+struct StripHeader {
+    uint32_t width;
+    uint32_t rows;          // rows in the strip
+    uint32_t first_row;     // row of the whole grid the strip starts at
+    uint64_t generations;
+    char     rule[32];
+    uint32_t below_ip;      // listening address of the worker below
+    uint16_t below_port;
+    uint8_t  has_above;
+    uint8_t  has_below;
+};
+
+// Returns the number of bytes a packed row takes up
+static size_t packed_row_bytes(int width){
+    return (width + 7) / 8;
+}
+
+// Packs a row of tiles into bits, eight tiles a byte
+static void pack_row(const char *row, int width, uint8_t *out){
+    std::memset(out, 0, packed_row_bytes(width));
+    for(int x=0; x<width; x++){
+        if( row[x] == '#' ){
+            out[x / 8] |= 1 << (x % 8);
+        }
+    }
+}
+
+// Unpacks a row packed by pack_row
+static void unpack_row(const uint8_t *in, int width, char *row){
+    for(int x=0; x<width; x++){
+        row[x] = ((in[x / 8] >> (x % 8)) & 1) ? '#' : ' ';
+    }
+}
+
+// Sends all of data through the socket, looping over short
+// sends. Throws a runtime exception on error.
+static void send_all(int socket_fd, const void *data, size_t length){
+    const char *bytes = (const char *) data;
+    while( length > 0 ){
+        ssize_t sent = send(socket_fd, bytes, length, MSG_NOSIGNAL);
+        if( sent < 0 && errno == EINTR ){
+            continue;
+        }
+        if( sent <= 0 ){
+            throw std::runtime_error("Failed to send to a peer.");
+        }
+        bytes  += sent;
+        length -= sent;
+    }
+}
+
+// Receives exactly 'length' bytes from the socket. Throws a
+// runtime exception on error or if the peer disconnects.
+static void recv_all(int socket_fd, void *data, size_t length){
+    char *bytes = (char *) data;
+    while( length > 0 ){
+        ssize_t received = recv(socket_fd, bytes, length, 0);
+        if( received < 0 && errno == EINTR ){
+            continue;
+        }
+        if( received <= 0 ){
+            throw std::runtime_error("Failed to receive from a peer.");
+        }
+        bytes  += received;
+        length -= received;
+    }
+}
+
+// Halo rows are small, so they are sent the moment they are
+// ready rather than waiting to be batched
+static void set_no_delay(int socket_fd){
+    int on = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+}
+
+///////////////////////////////////////////////////////////
+// Sends a worker's edge rows to its neighbors from a thread
+// of its own, so the worker can update its interior rows
+// while they are in flight.
+///////////////////////////////////////////////////////////
+class HaloSender {
+
+    int above_fd;
+    int below_fd;
+    int width;
+
+    // Rows waiting to be sent; left alone by the worker
+    // until wait returns
+    const char *top;
+    const char *bottom;
+
+    std::vector<uint8_t>    packed;
+    std::string             error;
+    bool                    pending;
+    bool                    stopping;
+    std::mutex              mut;
+    std::condition_variable cond;
+    std::thread             sender;
+
+    // Body of the sender thread
+    void send_loop(){
+        std::unique_lock lock(mut);
+        while( true ){
+            cond.wait(lock, [this]{ return pending || stopping; });
+            if( !pending ){
+                return;
+            }
+            lock.unlock();
+            std::string failure;
+            try {
+                if( above_fd >= 0 ){
+                    pack_row(top, width, packed.data());
+                    send_all(above_fd, packed.data(), packed.size());
+                }
+                if( below_fd >= 0 ){
+                    pack_row(bottom, width, packed.data());
+                    send_all(below_fd, packed.data(), packed.size());
+                }
+            } catch (std::exception& e) {
+                failure = e.what();
+            }
+            lock.lock();
+            error   = failure;
+            pending = false;
+            cond.notify_all();
+        }
+    }
+
+    public:
+
+    // Starts sending the top row to the worker above and the
+    // bottom row to the worker below
+    // Precondition: the previous rows have been waited for
+    void post(const char *top, const char *bottom){
+        std::lock_guard lock(mut);
+        this->top    = top;
+        this->bottom = bottom;
+        pending      = true;
+        cond.notify_all();
+    }
+
+    // Returns once the posted rows are sent. Throws a runtime
+    // exception if sending them failed.
+    void wait(){
+        std::unique_lock lock(mut);
+        cond.wait(lock, [this]{ return !pending; });
+        if( !error.empty() ){
+            throw std::runtime_error(error);
+        }
+    }
+
+    // Constructor: Starts the sender thread. A descriptor of
+    // -1 means there is no neighbor on that side.
+    HaloSender(int above_fd, int below_fd, int width)
+        : above_fd(above_fd)
+        , below_fd(below_fd)
+        , width(width)
+        , top(nullptr)
+        , bottom(nullptr)
+        , packed(packed_row_bytes(width))
+        , pending(false)
+        , stopping(false)
+    {
+        sender = std::thread(&HaloSender::send_loop, this);
+    }
+
+    // Destructor: finishes any rows being sent and stops the
+    // sender thread
+    ~HaloSender(){
+        {
+            std::lock_guard lock(mut);
+            stopping = true;
+        }
+        cond.notify_all();
+        sender.join();
+    }
+
+};
+
+// Runs the grid forward by the input number of generations
+// across 'workers' worker processes, leaving the result in
+// the grid
+// Precondition: 0 < workers <= the grid's height and
+//               generations > 0
+void coordinate(Grid& grid, const Rule& rule, long generations, int workers){
+    int width  = grid.get_width();
+    int height = grid.get_height();
+    size_t row_bytes = packed_row_bytes(width);
+
+    int listen_fd = arbitrary_socket();
+    if( listen(listen_fd, workers) < 0 ){
+        close(listen_fd);
+        throw std::runtime_error("Listening failed.");
+    }
+    std::cout << "Waiting for " << workers << " workers: run 'p3 worker <ip> " << get_port(listen_fd) << "'"
+              << std::endl;
+
+    // Each worker connects and reports the port it listens
+    // on for the worker above it
+    std::vector<int>       worker_fds;
+    std::vector<in_addr_t> worker_ips;
+    std::vector<in_port_t> worker_ports;
+    while( (int) worker_fds.size() < workers ){
+        sockaddr_in peer;
+        socklen_t   peer_len = sizeof(peer);
+        int worker_fd = accept(listen_fd, (sockaddr *) &peer, &peer_len);
+        if( worker_fd < 0 ){
+            continue;
+        }
+        uint16_t port;
+        try {
+            recv_all(worker_fd, &port, sizeof(port));
+        } catch (std::exception& e) {
+            close(worker_fd);
+            continue;
+        }
+        worker_fds.push_back(worker_fd);
+        worker_ips.push_back(peer.sin_addr.s_addr);
+        worker_ports.push_back(ntohs(port));
+        std::cout << "Worker " << worker_fds.size() << " connected from " << inet_ntoa(peer.sin_addr)
+                  << std::endl;
+    }
+    close(listen_fd);
+
+    try {
+        // Hand out the strips
+        std::vector<uint8_t> packed(row_bytes);
+        std::string rule_text = rule.to_string();
+        for(int i=0; i<workers; i++){
+            int first = (long) height *  i      / workers;
+            int end   = (long) height * (i + 1) / workers;
+
+            StripHeader header;
+            std::memset(&header, 0, sizeof(header));
+            header.width       = htonl(width);
+            header.rows        = htonl(end - first);
+            header.first_row   = htonl(first);
+            header.generations = htobe64(generations);
+            std::strncpy(header.rule, rule_text.c_str(), sizeof(header.rule) - 1);
+            header.has_above   = (i > 0);
+            header.has_below   = (i + 1 < workers);
+            if( header.has_below ){
+                header.below_ip   = worker_ips[i+1];
+                header.below_port = htons(worker_ports[i+1]);
+            }
+            send_all(worker_fds[i], &header, sizeof(header));
+            for(int y=first; y<end; y++){
+                pack_row(grid.row(y), width, packed.data());
+                send_all(worker_fds[i], packed.data(), row_bytes);
+            }
+        }
+
+        // Gather them back once the workers are done
+        for(int i=0; i<workers; i++){
+            int first = (long) height *  i      / workers;
+            int end   = (long) height * (i + 1) / workers;
+            for(int y=first; y<end; y++){
+                recv_all(worker_fds[i], packed.data(), row_bytes);
+                unpack_row(packed.data(), width, grid.row(y));
+            }
+        }
+    } catch (std::exception& e) {
+        for(int worker_fd : worker_fds){
+            close(worker_fd);
+        }
+        throw;
+    }
+    for(int worker_fd : worker_fds){
+        close(worker_fd);
+    }
+}
+
+// Receives the neighbors' edge rows into the ghost rows
+// above and below the strip
+static void receive_halo(Grid& grid, int rows, int above_fd, int below_fd, std::vector<uint8_t>& packed){
+    int width = grid.get_width();
+    if( above_fd >= 0 ){
+        recv_all(above_fd, packed.data(), packed.size());
+        unpack_row(packed.data(), width, grid.row(0));
+    }
+    if( below_fd >= 0 ){
+        recv_all(below_fd, packed.data(), packed.size());
+        unpack_row(packed.data(), width, grid.row(rows + 1));
+    }
+}
+
+// Updates a strip that sits in rows 1 to 'rows' of src and
+// dst, with ghost rows holding the neighbors' edges above
+// and below it. Each generation the edge rows are updated
+// first and handed to the sender, then the interior rows are
+// updated while they are in flight.
+static void run_strip(Grid *src, Grid *dst, int rows, long generations, const Rule& rule,
+                      int above_fd, int below_fd){
+    StepFunction step = select_kernel(rule);
+    HaloSender sender(above_fd, below_fd, src->get_width());
+    std::vector<uint8_t> packed(packed_row_bytes(src->get_width()));
+
+    // Trade the starting edges
+    sender.post(src->row(1), src->row(rows));
+    receive_halo(*src, rows, above_fd, below_fd, packed);
+    sender.wait();
+
+    for(long g=1; g<=generations; g++){
+        step(*src, *dst, rule, 1, 2);
+        if( rows > 1 ){
+            step(*src, *dst, rule, rows, rows + 1);
+        }
+        // Nobody needs the edges of the last generation
+        bool trade = (g < generations);
+        if( trade ){
+            sender.post(dst->row(1), dst->row(rows));
+        }
+        if( rows > 2 ){
+            step(*src, *dst, rule, 2, rows);
+        }
+        if( trade ){
+            receive_halo(*dst, rows, above_fd, below_fd, packed);
+            sender.wait();
+        }
+        std::swap(src, dst);
+    }
+    // The result is always left in the caller's src
+    if( generations % 2 == 1 ){
+        dst->copy_from(*src);
+    }
+}
+
+// Connects to the coordinator at ip/port and computes the
+// strip it is handed, returning once the strip has been
+// sent back
+void run_worker(in_addr_t ip, in_port_t port){
+    int coordinator_fd = connect_to(ip, port);
+    int listen_fd = -1;
+    int above_fd  = -1;
+    int below_fd  = -1;
+    Grid *src = nullptr;
+    Grid *dst = nullptr;
+
+    try {
+        // Report where the worker above can reach this one
+        listen_fd = arbitrary_socket();
+        if( listen(listen_fd, 1) < 0 ){
+            throw std::runtime_error("Listening failed.");
+        }
+        uint16_t listen_port = htons(get_port(listen_fd));
+        send_all(coordinator_fd, &listen_port, sizeof(listen_port));
+
+        StripHeader header;
+        recv_all(coordinator_fd, &header, sizeof(header));
+        int  width       = ntohl(header.width);
+        int  rows        = ntohl(header.rows);
+        int  first_row   = ntohl(header.first_row);
+        long generations = be64toh(header.generations);
+        Rule rule;
+        if( width <= 0 || rows <= 0 || generations <= 0 ||
+            std::memchr(header.rule, '\0', sizeof(header.rule)) == nullptr ||
+            !Rule::parse(header.rule, rule) ){
+            throw std::runtime_error("Received a malformed strip.");
+        }
+        std::cout << "Computing rows " << first_row << " to " << first_row + rows - 1 << " for "
+                  << generations << " generations" << std::endl;
+
+        // The strip plus a ghost row above and below it, which
+        // stay dead at the edges of the grid
+        src = new Grid(width, rows + 2);
+        dst = new Grid(width, rows + 2);
+        std::vector<uint8_t> packed(packed_row_bytes(width));
+        for(int y=1; y<=rows; y++){
+            recv_all(coordinator_fd, packed.data(), packed.size());
+            unpack_row(packed.data(), width, src->row(y));
+        }
+
+        // Connect downward before accepting from above, so no
+        // two workers wait on each other
+        if( header.has_below ){
+            below_fd = connect_to(header.below_ip, ntohs(header.below_port));
+            set_no_delay(below_fd);
+        }
+        if( header.has_above ){
+            above_fd = accept(listen_fd, nullptr, nullptr);
+            if( above_fd < 0 ){
+                throw std::runtime_error("Could not accept the worker above.");
+            }
+            set_no_delay(above_fd);
+        }
+        close(listen_fd);
+        listen_fd = -1;
+
+        run_strip(src, dst, rows, generations, rule, above_fd, below_fd);
+
+        for(int y=1; y<=rows; y++){
+            pack_row(src->row(y), width, packed.data());
+            send_all(coordinator_fd, packed.data(), packed.size());
+        }
+    } catch (std::exception& e) {
+        for(int fd : {coordinator_fd, listen_fd, above_fd, below_fd}){
+            if( fd >= 0 ){
+                close(fd);
+            }
+        }
+        delete src;
+        delete dst;
+        throw;
+    }
+    for(int fd : {coordinator_fd, above_fd, below_fd}){
+        if( fd >= 0 ){
+            close(fd);
+        }
+    }
+    delete src;
+    delete dst;
+}
+
+// Parses a string to an ip address. Throws a runtime
+// exception if it is not one.
+in_addr_t parse_ip(const char *ip_str){
+    in_addr_t ip_addr = inet_addr(ip_str);
+    if( ip_addr == INADDR_NONE ){
+        throw std::runtime_error("Failed to convert input ip address.");
+    }
+    return ip_addr;
+}
+
+// Parses a string to a port number. Throws a runtime
+// exception if it is not one.
+in_port_t parse_port(const char *port_str){
+    in_port_t port = atoi(port_str);
+    // 'atoi' returns zero on error, and port zero is not a
+    // 'real' port
+    if( port == 0 ){
+        throw std::runtime_error("Invalid port argument.");
+    }
+    return port;
+}
+
+// Returns a tcp/ip socket. Throws a runtime exception if one
+// cannot be allocated.
+static int make_tcp_ip_socket(){
+    int socket_fd = socket(PF_INET, SOCK_STREAM, 0);
+    if( socket_fd < 0 ){
+        throw std::runtime_error("Could not allocate socket.");
+    }
+    return socket_fd;
+}
+
+// Returns a socket connected to the given ip address and
+// port number. Throws a runtime exception if the connection
+// fails.
+int connect_to(in_addr_t ip, in_port_t port){
+    sockaddr_in socket_addr;
+    std::memset(&socket_addr, 0, sizeof(socket_addr));
+    socket_addr.sin_family      = AF_INET;
+    socket_addr.sin_addr.s_addr = ip;
+    socket_addr.sin_port        = htons(port);
+
+    int socket_fd = make_tcp_ip_socket();
+    if( connect(socket_fd, (sockaddr *) &socket_addr, sizeof(socket_addr)) < 0 ){
+        close(socket_fd);
+        throw std::runtime_error("Connection failed.");
+    }
+    return socket_fd;
+}
+
+// Returns a socket bound to an arbitrary port. Throws a
+// runtime exception if binding fails.
+int arbitrary_socket(){
+    sockaddr_in socket_addr;
+    std::memset(&socket_addr, 0, sizeof(socket_addr));
+    socket_addr.sin_family      = AF_INET;
+    socket_addr.sin_addr.s_addr = INADDR_ANY;
+    // Port zero lets the OS pick any available port
+    socket_addr.sin_port        = 0;
+
+    int socket_fd = make_tcp_ip_socket();
+    if( bind(socket_fd, (sockaddr *) &socket_addr, sizeof(socket_addr)) < 0 ){
+        close(socket_fd);
+        throw std::runtime_error("Binding failed.");
+    }
+    return socket_fd;
+}
+
+// Returns the port that the provided socket is bound to.
+// Throws a runtime exception if it cannot be found.
+in_port_t get_port(int socket_fd){
+    sockaddr_in socket_addr;
+    socklen_t socklen = sizeof(socket_addr);
+    if( getsockname(socket_fd, (sockaddr *) &socket_addr, &socklen) < 0 ){
+        throw std::runtime_error("Failed to find socket's port number.");
+    }
+    return ntohs(socket_addr.sin_port);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <string>
+#include <arpa/inet.h>
+#include "grid.h"
+#include "rule.h"
+
+// A distributed run splits the grid into horizontal strips,
+// one per worker process. The coordinator listens on an
+// arbitrary port and waits for the workers to connect with
+// 'p3 worker <ip> <port>'. It then sends each worker its
+// strip and the address of the worker below it. Neighboring
+// workers connect to each other and trade their edge rows
+// every generation. At the end, the strips are gathered back
+// to the coordinator. Rows travel bit-packed. Every function
+// here throws a runtime exception if a connection fails.
+
+// Runs the grid forward by the input number of generations
+// across 'workers' worker processes, leaving the result in
+// the grid
+// Precondition: 0 < workers <= the grid's height and
+//               generations > 0
+void coordinate(Grid& grid, const Rule& rule, long generations, int workers);
+
+// Connects to the coordinator at ip/port and computes the
+// strip it is handed, returning once the strip has been
+// sent back
+void run_worker(in_addr_t ip, in_port_t port);
+
+// Functions for parsing ip addresses and port numbers from
+// c strings, as in p4
+in_addr_t parse_ip(const char *ip_str);
+in_port_t parse_port(const char *port_str);
+
+// Returns a socket file descriptor that is connected to the
+// given ip/port
+int connect_to(in_addr_t ip, in_port_t port);
+
+// Returns a socket bound to an arbitrary port
+int arbitrary_socket();
+
+// Returns the port of the socket referenced by the input
+// file descriptor
+in_port_t get_port(int socket_fd);
@@ -1,6 +1,7 @@
 #include <iostream>
 #include "grid.h"
-#include <unistd.h>
+#include <cstring>
+#include <vector>
 
 // Reports whether or not the input coordinates
 // correspond to a valid position in the grid
@@ -29,6 +30,13 @@ void Grid::set_tile(int x, int y, bool value){
     buffer[index] = value ? '#' : ' ';
 }
 
+// Overwrites every tile with the state of the matching
+// tile in the input grid (other)
+// Precondition: both grids must have the same dimensions
+void Grid::copy_from(Grid& other){
+    std::memcpy(buffer, other.buffer, (width+1)*height);
+}
+
 // Returns grid width
 int Grid::get_width(){
     return width;
@@ -47,49 +55,12 @@ void Grid::print(){
     std::cout.flush();
 }
 
-// Overwrites the state of the tile identified by the
-// input coordinates, following the rules of Conway's
-// Game of Life and using the input grid (other) as
-// the state of the preceding generation.
-// Precondition: coordinates must be valid for the grid
-void Grid::update_tile(Grid& other, int x, int y){
-    // Intentional delay
-    usleep(100);
-
-    // Check if cell was alive in previous state
-    bool alive = other.get_tile(x,y);
-
-    // For each cell in the 3x3 grid centered on the
-    // input coordinates in the input Grid 'other'...
-    int count  = 0;
-    for(int i=-1; i<=1; i++){
-        for(int j=-1; j<=1; j++){
-            // ... do nothing for the cell exactly
-            // at (x,y)
-            if( (i==0) && (j==0) ){
-                continue;
-            }
-
-            // Add one to the count if adjacent
-            // cells are alive
-            int query_x = x+i;
-            int query_y = y+j;
-            if( !other.exists(query_x,query_y)){
-                continue;
-            }
-            if( other.get_tile(query_x,query_y) ){
-                count += 1;
-            }
-        }
-    }
-
-    // Cell is born if 3 adjacent cells are alive
-    // Cell keeps living if 2 or 3 adjacent cells are alive
-    if( (count == 2 && alive) || (count == 3) ){
-        set_tile(x,y,true);
-    } else {
-        set_tile(x,y,false);
-    }
+// Returns a pointer to the first tile of the input row.
+// Tiles are stored as '#' (alive) or ' ' (dead), one
+// character each.
+// Precondition: y must be a valid row for the grid
+char *Grid::row(int y){
+    return buffer + (width+1) * y;
 }
 
 // Constructor: Creates a grid with dimensions matching
@@ -122,36 +93,33 @@ Grid::Grid(std::string file_name)
     width  = 0;
     height = 0;
     std::string line;
+    std::vector<std::string> lines;
 
+    // Read the file once, keeping its lines.
     // Determine height by the number of lines
     // Determine width  by the maximum line width
     while(std::getline(file,line)){
         int line_size = line.size();
         width = (width>line_size) ? width : line.size();
         height++;
+        lines.push_back(std::move(line));
     }
 
     // Allocate character buffer to store tile data
     buffer = new char[(width+1)*height];
 
-    // Reset position in the file to the start
-    file.clear();
-    file.seekg(0,std::ios::beg);
-
     // Initialize each row based off of each line in
     // the file
-    int y = 0;
-    while(std::getline(file,line)){
+    for(int y=0; y<height; y++){
+        int line_size = lines[y].size();
         for(int x=0; x<width; x++){
             bool val = false;
-            int line_size = line.size();
             if( x<line_size ){
-                val = line[x] != ' ';
+                val = lines[y][x] != ' ';
             }
             this->set_tile(x,y,val);
         }
         buffer[(width+1)*y+width] = '\n';
-        y++;
     }
 }
 
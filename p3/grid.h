@@ -1,3 +1,5 @@
+#pragma once
+
 #include <fstream>
 
 ///////////////////////////////////////////////////////////
@@ -25,6 +27,11 @@ class Grid {
     // Precondition: coordinates must be valid for the grid
     void set_tile(int x, int y, bool value);
 
+    // Overwrites every tile with the state of the matching
+    // tile in the input grid (other)
+    // Precondition: both grids must have the same dimensions
+    void copy_from(Grid& other);
+
     public:
 
     // Returns whether or not the cell/tile at the input
@@ -32,12 +39,11 @@ class Grid {
     // Precondition: coordinates must be valid for the grid
     void print();
 
-    // Overwrites the state of the tile identified by the
-    // input coordinates, following the rules of Conway's
-    // Game of Life and using the input grid (other) as
-    // the state of the preceding generation.
-    // Precondition: coordinates must be valid for the grid
-    void update_tile(Grid& other, int x, int y);
+    // Returns a pointer to the first tile of the input row.
+    // Tiles are stored as '#' (alive) or ' ' (dead), one
+    // character each.
+    // Precondition: y must be a valid row for the grid
+    char *row(int y);
 
     // Returns grid width
     int get_width();
@@ -0,0 +1,332 @@
+#include "kernel.h"
+#include <array>
+#include <vector>
+#include <algorithm>
+
+// Looks up next states through a rule's table at run time
+struct TableLookup {
+    const uint8_t *table;
+    uint8_t operator()(int index) const {
+        return table[index];
+    }
+};
+
+// Looks up next states through a table built at compile
+// time for one rule
+template <uint16_t BIRTH, uint16_t SURVIVAL>
+struct FixedLookup {
+    static constexpr std::array<uint8_t,512> build(){
+        std::array<uint8_t,512> result{};
+        for(int index=0; index<512; index++){
+            result[index] = Rule::next_state(BIRTH, SURVIVAL, index);
+        }
+        return result;
+    }
+    static constexpr std::array<uint8_t,512> table = build();
+    uint8_t operator()(int index) const {
+        return table[index];
+    }
+};
+
+// Returns the three tiles of column x (top to bottom in
+// bits 0-2) across the input rows
+static inline int column(const char *above, const char *row, const char *below, int x){
+    return  (above[x] == '#')
+         | ((row[x]   == '#') << 1)
+         | ((below[x] == '#') << 2);
+}
+
+// Row hashes take in the row's tiles 64 at a time
+static const uint64_t HASH_SEED  = 0xcbf29ce484222325ULL;
+static const uint64_t HASH_PRIME = 0x100000001b3ULL;
+
+// Scrambles a row hash together with its row index so equal
+// rows at different heights contribute differently
+static inline uint64_t mix_row(uint64_t row_hash, int y){
+    uint64_t z = row_hash + (uint64_t) y * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+// Folds in the summary of another strip of the same
+// generation
+void StepSummary::merge(const StepSummary& other){
+    hash       += other.hash;
+    population += other.population;
+    births     += other.births;
+    deaths     += other.deaths;
+    min_x = std::min(min_x, other.min_x);
+    min_y = std::min(min_y, other.min_y);
+    max_x = std::max(max_x, other.max_x);
+    max_y = std::max(max_y, other.max_y);
+}
+
+// Accumulates one row of a summary a word of 64 tiles at a
+// time: 'now' holds the new states and 'was' the preceding
+// ones, for the tiles starting at column x
+struct RowSummary {
+    uint64_t hash  = HASH_SEED;
+    int      first = -1;
+    int      last  = -1;
+
+    void add(StepSummary& summary, uint64_t now, uint64_t was, int x){
+        hash = (hash ^ now) * HASH_PRIME;
+        summary.population += __builtin_popcountll(now);
+        summary.births     += __builtin_popcountll(now & ~was);
+        summary.deaths     += __builtin_popcountll(was & ~now);
+        if( now != 0 ){
+            if( first < 0 ){
+                first = x + __builtin_ctzll(now);
+            }
+            last = x + 63 - __builtin_clzll(now);
+        }
+    }
+
+    void finish(StepSummary& summary, int y){
+        summary.hash += mix_row(hash, y);
+        if( first >= 0 ){
+            summary.min_x = std::min(summary.min_x, first);
+            summary.max_x = std::max(summary.max_x, last);
+            summary.min_y = std::min(summary.min_y, y);
+            summary.max_y = std::max(summary.max_y, y);
+        }
+    }
+};
+
+// Returns the summary a kernel would report for the whole
+// of the input grid, with no births or deaths
+StepSummary summarize_grid(Grid& grid){
+    StepSummary summary;
+    for(int y=0; y<grid.get_height(); y++){
+        const char *row = grid.row(y);
+        RowSummary  row_summary;
+        uint64_t    word = 0;
+        int         bits = 0;
+        for(int x=0; x<grid.get_width(); x++){
+            word |= (uint64_t) (row[x] == '#') << bits;
+            if( ++bits == 64 ){
+                row_summary.add(summary, word, word, x - 63);
+                word = 0;
+                bits = 0;
+            }
+        }
+        row_summary.add(summary, word, word, grid.get_width() - bits);
+        row_summary.finish(summary, y);
+    }
+    return summary;
+}
+
+// Writes the generation following row (between above and
+// below) into out, which is row y of a grid of the input
+// width. The 3x3 neighborhood index slides along the row,
+// so a tile costs one new column of reads and one table
+// lookup. When SUMMARIZE is set, new and old states are
+// also packed into words, from which the summary is built
+// 64 tiles at a time.
+template <bool SUMMARIZE, class Lookup>
+static inline void step_row(const char *above, const char *row, const char *below, char *out,
+                            int width, int y, StepSummary& summary, Lookup lookup){
+    RowSummary row_summary;
+    uint64_t   now  = 0;
+    uint64_t   was  = 0;
+    int        bits = 0;
+
+    // The column left of x=0 is outside the grid
+    int index = column(above,row,below,0) << 3;
+    if( width > 1 ){
+        index |= column(above,row,below,1) << 6;
+    }
+    for(int x=0; x<width; x++){
+        uint64_t alive = lookup(index);
+        out[x] = alive ? '#' : ' ';
+        if( SUMMARIZE ){
+            now |= alive << bits;
+            was |= (uint64_t) ((index >> 4) & 1) << bits;
+            if( ++bits == 64 ){
+                row_summary.add(summary, now, was, x - 63);
+                now  = 0;
+                was  = 0;
+                bits = 0;
+            }
+        }
+        index >>= 3;
+        if( x+2 < width ){
+            index |= column(above,row,below,x+2) << 6;
+        }
+    }
+    if( SUMMARIZE ){
+        row_summary.add(summary, now, was, width - bits);
+        row_summary.finish(summary, y);
+    }
+}
+
+// Advances rows [y_begin, y_end) of dst by one generation
+template <class Lookup>
+static StepSummary step_rows(Grid& src, Grid& dst, int y_begin, int y_end, Lookup lookup){
+    int width  = src.get_width();
+    int height = src.get_height();
+    // Rows above the top and below the bottom read as dead
+    std::vector<char> dead(width+1, ' ');
+    StepSummary summary;
+
+    for(int y=y_begin; y<y_end; y++){
+        const char *above = (y > 0)        ? src.row(y-1) : dead.data();
+        const char *below = (y+1 < height) ? src.row(y+1) : dead.data();
+        step_row<true>(above, src.row(y), below, dst.row(y), width, y, summary, lookup);
+    }
+    return summary;
+}
+
+// Scratch space a block is advanced in is kept to about this
+// many bytes, so a block's rows stay in cache across all of
+// its generations
+static const size_t BLOCK_BYTES = 1 << 20;
+
+// Advances rows [y_begin, y_end) of dst by the input number
+// of generations. The rows are cut into blocks that are each
+// taken through every generation before moving on: a block
+// starts out with 'generations' extra rows on either side,
+// and every generation the rows that can still be computed
+// exactly shrink by one on each side, leaving just the
+// block's own rows after the last one. The overlapping rows
+// are computed more than once, but the grid itself is only
+// read once and written once.
+template <class Lookup>
+static StepSummary step_rows_blocked(Grid& src, Grid& dst, int y_begin, int y_end, int generations,
+                                     Lookup lookup){
+    if( generations == 1 ){
+        return step_rows(src, dst, y_begin, y_end, lookup);
+    }
+    int width  = src.get_width();
+    int height = src.get_height();
+    size_t stride = width + 1;
+    std::vector<char> dead(stride, ' ');
+    StepSummary summary;
+
+    // Two ping-pong buffers of block rows plus both halos
+    long fit   = std::max((long) (BLOCK_BYTES / (2 * stride)) - 2L * generations, 4L * generations);
+    int  block = std::min(fit, (long) std::max(y_end - y_begin, 1));
+    std::vector<char> scratch[2];
+    scratch[0].resize((block + 2 * generations) * stride);
+    scratch[1].resize((block + 2 * generations) * stride);
+
+    for(int b_begin=y_begin; b_begin<y_end; b_begin+=block){
+        int b_end = std::min(b_begin + block, y_end);
+        // Row y of the block's scratch buffers is row y-first
+        int first = b_begin - generations;
+
+        for(int g=1; g<=generations; g++){
+            const char *in  = scratch[(g+1) % 2].data();
+            char       *out = scratch[g % 2].data();
+            // Returns row y of the preceding generation
+            auto previous = [&](int y) -> const char * {
+                if( y < 0 || y >= height ){
+                    return dead.data();
+                }
+                return (g == 1) ? src.row(y) : in + (y - first) * stride;
+            };
+            int lo = std::max(b_begin - generations + g, 0);
+            int hi = std::min(b_end   + generations - g, height);
+            if( g < generations ){
+                for(int y=lo; y<hi; y++){
+                    step_row<false>(previous(y-1), previous(y), previous(y+1), out + (y - first) * stride,
+                                    width, y, summary, lookup);
+                }
+            } else {
+                for(int y=lo; y<hi; y++){
+                    step_row<true>(previous(y-1), previous(y), previous(y+1), dst.row(y),
+                                   width, y, summary, lookup);
+                }
+            }
+        }
+    }
+    return summary;
+}
+
+template <uint16_t BIRTH, uint16_t SURVIVAL>
+static StepSummary step_fixed(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end){
+    return step_rows(src, dst, y_begin, y_end, FixedLookup<BIRTH,SURVIVAL>());
+}
+
+static StepSummary step_table(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end){
+    return step_rows(src, dst, y_begin, y_end, TableLookup{rule.get_table()});
+}
+
+template <uint16_t BIRTH, uint16_t SURVIVAL>
+static StepSummary block_fixed(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end, int generations){
+    return step_rows_blocked(src, dst, y_begin, y_end, generations, FixedLookup<BIRTH,SURVIVAL>());
+}
+
+static StepSummary block_table(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end, int generations){
+    return step_rows_blocked(src, dst, y_begin, y_end, generations, TableLookup{rule.get_table()});
+}
+
+// Rules that get a kernel of their own
+struct SpecializedRule {
+    const char  *name;
+    uint16_t     birth;
+    uint16_t     survival;
+    StepFunction  step;
+    BlockFunction block;
+};
+
+#define SPECIALIZE(name,b,s) { name, Rule::mask(b), Rule::mask(s), \
+                               step_fixed<Rule::mask(b),Rule::mask(s)>, block_fixed<Rule::mask(b),Rule::mask(s)> }
+static const SpecializedRule SPECIALIZED[] = {
+    SPECIALIZE("life",        "3",    "23"),
+    SPECIALIZE("highlife",    "36",   "23"),
+    SPECIALIZE("seeds",       "2",    ""),
+    SPECIALIZE("daynight",    "3678", "34678"),
+    SPECIALIZE("maze",        "3",    "12345"),
+    SPECIALIZE("2x2",         "36",   "125"),
+    SPECIALIZE("replicator",  "1357", "1357"),
+    SPECIALIZE("lifewithoutdeath", "3", "012345678"),
+};
+#undef SPECIALIZE
+
+// Returns the kernel to use for the input rule. Well-known
+// rules get a kernel compiled for that rule alone; any
+// other rule is run through its lookup table.
+StepFunction select_kernel(const Rule& rule){
+    for(const SpecializedRule& entry : SPECIALIZED){
+        if( entry.birth == rule.get_birth() && entry.survival == rule.get_survival() ){
+            return entry.step;
+        }
+    }
+    return step_table;
+}
+
+// Returns the generic kernel that runs any rule through its
+// lookup table
+StepFunction table_kernel(){
+    return step_table;
+}
+
+// Returns the blocked kernel to use for the input rule,
+// chosen the same way as select_kernel
+BlockFunction select_block_kernel(const Rule& rule){
+    for(const SpecializedRule& entry : SPECIALIZED){
+        if( entry.birth == rule.get_birth() && entry.survival == rule.get_survival() ){
+            return entry.block;
+        }
+    }
+    return block_table;
+}
+
+// Returns the blocked kernel that runs any rule through its
+// lookup table
+BlockFunction table_block_kernel(){
+    return block_table;
+}
+
+// Returns the name of the kernel select_kernel would pick,
+// for reporting
+std::string kernel_name(const Rule& rule){
+    for(const SpecializedRule& entry : SPECIALIZED){
+        if( entry.birth == rule.get_birth() && entry.survival == rule.get_survival() ){
+            return std::string("fixed:") + entry.name;
+        }
+    }
+    return "table";
+}
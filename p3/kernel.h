@@ -0,0 +1,79 @@
+#pragma once
+
+#include "grid.h"
+#include "rule.h"
+
+#include <cstdint>
+#include <climits>
+
+// Facts about the rows a kernel call wrote, gathered while
+// writing them so no second pass over the grid is needed.
+// Summaries of separate strips merge into the summary of
+// the whole grid.
+struct StepSummary {
+    // Hash of the written rows. Each row's hash is mixed with
+    // its row index and the results summed, so strips can be
+    // merged in any order.
+    uint64_t hash = 0;
+
+    // Live tiles, and tiles that came alive or died relative
+    // to the preceding generation
+    long population = 0;
+    long births     = 0;
+    long deaths     = 0;
+
+    // Bounding box of the live tiles, inclusive. Left at
+    // min > max when there are none.
+    int min_x = INT_MAX;
+    int min_y = INT_MAX;
+    int max_x = -1;
+    int max_y = -1;
+
+    // Folds in the summary of another strip of the same
+    // generation
+    void merge(const StepSummary& other);
+};
+
+// Advances rows [y_begin, y_end) of dst by one generation,
+// using src as the preceding generation. Tiles outside the
+// grid are treated as dead.
+// Precondition: src and dst have the same dimensions and
+//               0 <= y_begin <= y_end <= height
+typedef StepSummary (*StepFunction)(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end);
+
+// Advances rows [y_begin, y_end) of dst by the input number
+// of generations at once, reading only src. Each block of
+// rows is taken through every generation while it is in
+// cache, recomputing the rows its neighbors depend on, so
+// the grid passes through memory once rather than once per
+// generation. The summary is that of the last generation.
+// Precondition: src and dst have the same dimensions,
+//               0 <= y_begin <= y_end <= height and
+//               generations >= 1
+typedef StepSummary (*BlockFunction)(Grid& src, Grid& dst, const Rule& rule, int y_begin, int y_end,
+                                     int generations);
+
+// Returns the summary a kernel would report for the whole
+// of the input grid, with no births or deaths
+StepSummary summarize_grid(Grid& grid);
+
+// Returns the kernel to use for the input rule. Well-known
+// rules get a kernel compiled for that rule alone; any
+// other rule is run through its lookup table.
+StepFunction select_kernel(const Rule& rule);
+
+// Returns the generic kernel that runs any rule through its
+// lookup table
+StepFunction table_kernel();
+
+// Returns the blocked kernel to use for the input rule,
+// chosen the same way as select_kernel
+BlockFunction select_block_kernel(const Rule& rule);
+
+// Returns the blocked kernel that runs any rule through its
+// lookup table
+BlockFunction table_block_kernel();
+
+// Returns the name of the kernel select_kernel would pick,
+// for reporting
+std::string kernel_name(const Rule& rule);
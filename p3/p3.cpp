@@ -3,6 +3,17 @@
 //This code implements Conway's Game of Life with multithreading
 
 #include "grid.h"
+#include "renderer.h"
+#include "triple_buffer.h"
+#include "rule.h"
+#include "kernel.h"
+#include "patterns.h"
+#include "checkpoint.h"
+#include "stepper.h"
+#include "cycle.h"
+#include "stats.h"
+#include "distributed.h"
+#include "control.h"
 #include <iostream>
 #include <string>
 #include <unistd.h>
@@ -12,61 +23,143 @@
 #include <mutex>
 #include <vector>
 #include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <algorithm>
+#include <sstream>
+#include <cctype>
 
 typedef void (*sighandler_t)(int);
 sighandler_t signal(int signum, sighandler_t handler);
 
-//global condition variables
-std::condition_variable menu_cond;      //to handle opening menu via SIGTSTP
-std::condition_variable ready_cond;     //to handle update and print threads to resume after "R" in menu
-std::condition_variable terminate_cond; //to handle returning for update and print threads
-std::mutex sig_mut;    //mutex that synchronizes update and print threads to the menu thread
-
-bool is_running = true;
-bool is_menu_active = false;
-bool is_terminated = false;
+//run state shared by the control, print and update threads. each is read and changed atomically, so a
+//command never waits on the other threads and they never wait on a command
+std::atomic<bool> is_running(true);
+std::atomic<bool> is_paused(false);
+std::atomic<long> steps_requested(0);   //generations to compute while paused
+std::atomic<int> sim_rate(10);          //generations per second
+std::atomic<int> frame_rate(10);        //frames per second
+std::atomic<bool> show_overlay(false);  //whether the summary is drawn under the board
+std::atomic<bool> needs_redraw(false);  //a typed command has written over the screen
+
+//wakes the print and update threads from their sleep so a command takes effect immediately
+std::mutex wake_mut;
+std::condition_variable wake_cond;
+
+//the summary of the latest generation, for the stats command, and the reply to the last typed command
+std::mutex latest_mut;
+StepSummary latest_summary;
+long latest_generation = 0;
+std::string terminal_message;
 
 //desc: handler for SIGINT signal
 //pre : -must only be evoked when a SIGINT is done by user
 //post: -program is exited with status code 2
 void sigint_handler(int signum) {
-    //set as not running, unblock the menu, and return from all threads
-    is_running = !is_running;
-    is_terminated = !is_terminated;
-    menu_cond.notify_one();
     std::cerr << "\nExiting immediately...\n";
     exit(2);
 }
 
-//desc: handler for SIGTSTP signal
-//pre : -must only be evoked when SIGTSTP is done by user
-//      -a declared global condition variable is assumed
-//post: -unlocks mutex that allows the menu thread to run
-void sigstp_handler(int signum) {
-    menu_cond.notify_all();
-    is_menu_active = !is_menu_active;
-}
-
-//desc: displays an input menu and stops all other processes while running
-//pre : -should only be invoked via SIGTSTP
-//post: -when 'Q' is the input, exit the whole program
-//      -when 'R' is the input, resume other processes
-void menu (int *frame_rate, int *sim_rate, Grid **display_grid, Grid **working_grid, std::mutex *mut);
+//desc: sleeps for the input number of milliseconds, or until a command wakes the thread
+//pre : none
+//post: none
+void wait_for_command(int milliseconds);
 
-//desc: prints the display grid
+//desc: wakes any thread sleeping in wait_for_command
 //pre : none
 //post: none
-void print_cycle (Grid **display_grid, int *frame_rate, std::mutex *mut);
+void wake_threads();
 
-//desc: updates the working grid and swaps grids after one iteration via thread
+//desc: sets a rate from a command, keeping it at least 1
 //pre : none
-//post: -all threads are synchronized correctly
-void update_grid (Grid **working_grid, Grid **display_grid, int *sim_rate, std::mutex *mut);
+//post: -returns the reply to the command
+std::string set_rate(std::atomic<int> *rate, int value, std::string name);
+
+//desc: carries out one line of the control channel: pause, resume, step [n], sim <rate>, fps <rate>,
+//      overlay [on|off], stats, quit and help. the single letters of the old menu
+//      (P, R, N, S+, S-, D+, D-, O, Q) also work, in either case
+//pre : none
+//post: -returns the reply to send back
+std::string handle_command(const std::string& line);
 
-//desc: updates one row of the working grid via thread
-//pre : -should be called only within the update thread
+//desc: shows the reply to a command typed at the terminal in the status line
+//pre : none
+//post: -the next frame is drawn in full, since typing has written over the screen
+void show_reply(const std::string& reply);
+
+//desc: reads commands from the terminal and the control socket (if any) until the run is quit
+//pre : none
+//post: none
+void control_cycle (ControlChannel *channel);
+
+//desc: prints the latest published generation, sending only what changed since the last frame, with its
+//      summary below the board when the overlay is on and the reply to the last typed command
+//pre : none
 //post: none
-void update_row (Grid *working_grid, Grid *display_grid, int x);
+void print_cycle (TripleBuffer *frames, Renderer *renderer);
+
+//desc: updates the working grid and swaps grids after one iteration via the stepper's threads, then publishes
+//      a copy of the new generation and its summary for the print thread, the checkpointer and stats (if any)
+//pre : -generation is the generation number of the display grid
+//      -stops updating once the detector (if any) finds the board has settled
+//      -while paused, only computes the generations asked for by the step command
+//post: -all threads are synchronized correctly
+//      -never waits on the print thread, the control channel or checkpoint writes
+void update_grid (Grid **working_grid, Grid **display_grid, TripleBuffer *frames, Rule *rule,
+                  long generation, Stepper *stepper, Checkpointer *checkpointer, CycleDetector *detector,
+                  StatsWriter *stats);
+
+//desc: runs without display or menu until the target generation, as fast as possible. if the board settles
+//      into a still life or cycle first, the remaining generations are skipped over using the period.
+//      generations are computed block_generations at a time with a blocked kernel where possible
+//pre : -generation is the generation number of the display grid
+//post: -the display grid holds the target generation
+//      -returns the exit status
+int run_batch (Grid **working_grid, Grid **display_grid, Rule *rule, long generation, long target,
+               Stepper *stepper, Checkpointer *checkpointer, CycleDetector *detector, StatsWriter *stats,
+               int block_generations);
+
+//settings for a run, filled in from the command line
+struct Options {
+    std::string file_path;
+    Renderer::Scale scale = Renderer::SCALE_AUTO;
+    int viewport[4] = {0, 0, 0, 0};
+    std::string rule;       //empty to use the pattern file's rule, or B3/S23 if it has none
+    std::string checkpoint_path;    //empty to disable checkpoints
+    long checkpoint_every = 1000;   //generations between checkpoints
+    int threads = 0;                //update threads, 0 for one per hardware thread
+    int history = 256;              //generations remembered to detect cycles, 0 to disable
+    long generations = 0;           //run without display up to this generation, 0 to run interactively
+    int block_generations = 1;      //generations a batch run computes per pass over the grid
+    std::string output_path;        //pattern file to write the final generation of a batch run to
+    std::string stats_path;         //file to stream per-generation statistics to, csv or .json(l)
+    std::string control_path;       //unix socket to accept commands on, besides the terminal
+    int workers = 0;                //worker processes to split a batch run across, 0 to run in this process
+    bool overlay = false;           //draw the statistics under the board
+};
+
+//desc: parses the pattern file and the optional arguments that follow it
+//pre : -argv[1] is the pattern file
+//post: -returns false if an argument is malformed or unrecognized
+bool parse_options(int argc, char *argv[], Options *options);
+
+//desc: converts a pattern between plain text, RLE and Macrocell, chosen by file extension
+//pre : -argv[2] and argv[3] are the input and output files
+//post: -returns the exit status
+int convert(int argc, char *argv[]);
+
+//desc: runs as a worker of a distributed run, computing the strip of rows the coordinator hands out
+//pre : -argv[2] and argv[3] are the coordinator's ip address and port
+//post: -returns the exit status
+int worker(int argc, char *argv[]);
+
+//desc: runs a batch run across worker processes, waiting for them to connect, then saves the result
+//pre : -options.workers and options.generations are positive
+//      -generation is the generation number of the grid
+//post: -the grid holds the target generation
+//      -returns the exit status
+int run_distributed(Grid *grid, const Rule& rule, long generation, const Options& options);
 
 //desc: runs Conway's Game of life with multithreading. input, printing, and updating will be in seperate threads
 //pre : -global conditionals, mutexes, and booleans are initialized before execution
@@ -75,178 +168,529 @@ void update_row (Grid *working_grid, Grid *display_grid, int x);
 int main(int argc, char *argv[]) {
     //initialize signal handlers, 
     signal(SIGINT, sigint_handler);
-    signal(SIGTSTP, sigstp_handler);
 
-    //if there are too few or too many arguments, stop
-    if (argc != 2) {
-        std::cerr << "Usage:\np3 <cgol_file.txt>\n";
+    if (argc >= 2 && std::string(argv[1]) == "convert") {
+        return convert(argc, argv);
+    }
+    if (argc >= 2 && std::string(argv[1]) == "worker") {
+        return worker(argc, argv);
+    }
+
+    //if there are too few arguments or any are malformed, stop
+    Options options;
+    if (argc < 2 || !parse_options(argc, argv, &options)) {
+        std::cerr << "Usage:\np3 <pattern.txt|.rle|.mc|checkpoint> [--scale auto|full|half|braille] [--viewport x,y,w,h] [--rule B3/S23]\n"
+                  << "   [--checkpoint <file>] [--checkpoint-every <generations>] [--threads <count>]\n"
+                  << "   [--history <generations>] [--generations <n> [--output <pattern>] [--block <generations>]]\n"
+                  << "   [--stats <file.csv|file.jsonl>] [--overlay on|off] [--workers <count>] [--control <socket>]\n"
+                  << "p3 convert <in_pattern> <out_pattern>\n"
+                  << "p3 worker <ip> <port>\n";
+        return 1;
+    }
+    if (options.workers > 0 && options.generations == 0) {
+        std::cerr << "--workers needs --generations\n";
+        return 1;
+    }
+
+    //load the pattern (or resume from a checkpoint), taking its rule unless one was given on the command line
+    Rule rule;
+    Grid *display_grid;
+    long generation = 0;
+    try {
+        if (is_checkpoint(options.file_path)) {
+            display_grid = restore_checkpoint(options.file_path, &generation, &rule);
+        } else {
+            display_grid = load_pattern(options.file_path, &rule);
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
         return 1;
     }
+    if (!options.rule.empty()) {
+        Rule::parse(options.rule, rule);
+    }
+
+    //distributed runs hand the grid to worker processes and only gather the last generation
+    if (options.workers > 0) {
+        int status = run_distributed(display_grid, rule, generation, options);
+        delete display_grid;
+        return status;
+    }
 
     //initialize objects, and method scoping variables
-    std::string file_path = argv[1];
-    Grid *display_grid = new Grid(file_path);
     Grid *working_grid = new Grid(display_grid->get_width(), display_grid->get_height());
-    int frame_rate = 10;
-    int sim_rate = 10;
-    std::mutex print_mut;
+    TripleBuffer frames(display_grid->get_width(), display_grid->get_height());
+    Renderer renderer(options.scale, options.viewport[0], options.viewport[1], options.viewport[2], options.viewport[3]);
+    Stepper stepper(options.threads);
+    Checkpointer *checkpointer = nullptr;
+    if (!options.checkpoint_path.empty()) {
+        checkpointer = new Checkpointer(options.checkpoint_path, options.checkpoint_every, rule,
+                                        display_grid->get_width(), display_grid->get_height());
+    }
+    StepSummary summary = summarize_grid(*display_grid);
+    CycleDetector *detector = nullptr;
+    if (options.history > 0) {
+        detector = new CycleDetector(options.history);
+        detector->record(summary.hash, generation);
+    }
+    StatsWriter *stats = nullptr;
+    if (!options.stats_path.empty()) {
+        try {
+            stats = new StatsWriter(options.stats_path);
+        } catch (std::exception& e) {
+            std::cerr << e.what() << "\n";
+            return 1;
+        }
+        stats->write(generation, summary);
+    }
+    show_overlay = options.overlay;
+
+    //batch runs skip the display and menu entirely
+    if (options.generations > 0) {
+        int status = run_batch(&working_grid, &display_grid, &rule, generation, options.generations,
+                               &stepper, checkpointer, detector, stats, options.block_generations);
+        if (status == 0 && !options.output_path.empty()) {
+            try {
+                save_pattern(options.output_path, *display_grid, rule);
+            } catch (std::exception& e) {
+                std::cerr << e.what() << "\n";
+                status = 1;
+            }
+        }
+        delete display_grid;
+        delete working_grid;
+        delete checkpointer;
+        delete detector;
+        delete stats;
+        return status;
+    }
+
+    //publish the initial generation so there is something to print immediately
+    frames.write_slot()->copy_from(*display_grid);
+    frames.publish(generation, summary);
+
+    latest_summary = summary;
+    latest_generation = generation;
+
+    //commands come from the terminal, and from the control socket if one was given
+    ControlChannel *channel;
+    try {
+        channel = new ControlChannel(options.control_path, handle_command, show_reply);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
 
-    std::thread input_menu(menu, &frame_rate, &sim_rate, &display_grid, &working_grid, &print_mut);
+    std::thread control (control_cycle, channel);
 
-    std::thread print (print_cycle, &display_grid, &frame_rate, &print_mut);
+    std::thread print (print_cycle, &frames, &renderer);
 
-    std::thread update (update_grid, &working_grid, &display_grid, &sim_rate, &print_mut);
+    std::thread update (update_grid, &working_grid, &display_grid, &frames, &rule, generation, &stepper,
+                        checkpointer, detector, stats);
 
-    input_menu.join();
+    control.join();
     print.join();
     update.join();
+    delete channel;
 
     //deallocate grids
     delete display_grid;
     delete working_grid;
+    delete checkpointer;
+    delete detector;
+    delete stats;
 
     return 0;
 }
 
 
-void menu (int *frame_rate, int *sim_rate, Grid **display_grid, Grid **working_grid, std::mutex *mut) {
-    std::string input;
-    while (is_running) {
-        //wait until the SIGTSTP is invoked
-        if(!is_menu_active) {
-            std::unique_lock ulock(*mut);
-            menu_cond.wait(ulock);
-        }
-
-        //in the case SIGINT is done while the menu is up
-        if (is_terminated) {
-            return;
-        }
-
-        std::cout << "\n\nCGOL Menu:\n\n\"Q\": quit the current game\n\"R\": exit the menu\n\"S+\": simulation rate increase by 1"
-                  << "\n\"S-\": simulation rate decrease by 1\n\"D+\": frame rate increase by 1\n\"D-\": frame rate decrease by 1\n";
-        std::cin >> input;
-        if (input == "Q") {
-        //return and deal with deallocation
-            kill(0,SIGINT);
-            ready_cond.notify_all();
-            is_running = false;
-            is_menu_active = false;
-            is_terminated = true;
-            std::unique_lock ulock(sig_mut);
-            terminate_cond.wait(ulock);
-            delete *display_grid;
-            delete *working_grid;
-            kill(0, SIGINT);
-            return;
-        } else if (input == "R") {
-        //unblock update and print threads and return to the simulation
-            std::cout << "\nReturning to the game...\n";
-            ready_cond.notify_all();
-            is_menu_active = false;
-        } else if (input == "S+") {
-        //sim rate up 1
-            (*sim_rate)++;
-            std::cout << "Simulation Rate has been increased by 1.\nIt is now: " << *sim_rate;
-        } else if (input == "S-") {
-        //sim rate down 1
-            if (*sim_rate == 0) {
-                std::cout << "Simulation Rate cannot be negative.\n";
-            }
-            (*sim_rate)--;
-            std::cout << "Simulation Rate has been decreased by 1.\nIt is now: " << *sim_rate;
-        } else if (input == "D+") {
-        //frame rate up 1
-            (*frame_rate)++;
-            std::cout << "Frame Rate has been increased by 1.\nIt is now: " << *frame_rate;
-        } else if (input == "D-") {
-        //frame rate down 1
-            if (*frame_rate == 0) {
-                std::cout << "Frame Rate cannot be negative.\n";
-            }
-            (*frame_rate)--;
-            std::cout << "Frame Rate has been decreased by 1.\nIt is now: " << *frame_rate;
+bool parse_options(int argc, char *argv[], Options *options) {
+    options->file_path = argv[1];
+    for (int i = 2; i < argc; i++) {
+        std::string option = argv[i];
+        //every option takes exactly one value
+        if (i + 1 >= argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        if (option == "--scale") {
+            if (!Renderer::parse_scale(value, options->scale)) {
+                return false;
+            }
+        } else if (option == "--rule") {
+            Rule rule;
+            if (!Rule::parse(value, rule)) {
+                return false;
+            }
+            options->rule = value;
+        } else if (option == "--checkpoint") {
+            options->checkpoint_path = value;
+        } else if (option == "--checkpoint-every") {
+            options->checkpoint_every = atol(value.c_str());
+            if (options->checkpoint_every <= 0) {
+                return false;
+            }
+        } else if (option == "--threads") {
+            options->threads = atoi(value.c_str());
+            if (options->threads <= 0) {
+                return false;
+            }
+        } else if (option == "--history") {
+            options->history = atoi(value.c_str());
+            if (options->history < 0) {
+                return false;
+            }
+        } else if (option == "--block") {
+            options->block_generations = atoi(value.c_str());
+            if (options->block_generations <= 0) {
+                return false;
+            }
+        } else if (option == "--generations") {
+            options->generations = atol(value.c_str());
+            if (options->generations <= 0) {
+                return false;
+            }
+        } else if (option == "--output") {
+            options->output_path = value;
+        } else if (option == "--workers") {
+            options->workers = atoi(value.c_str());
+            if (options->workers <= 0) {
+                return false;
+            }
+        } else if (option == "--control") {
+            options->control_path = value;
+        } else if (option == "--stats") {
+            options->stats_path = value;
+        } else if (option == "--overlay") {
+            if (value != "on" && value != "off") {
+                return false;
+            }
+            options->overlay = (value == "on");
+        } else if (option == "--viewport") {
+            int *viewport = options->viewport;
+            if (sscanf(value.c_str(), "%d,%d,%d,%d", &viewport[0], &viewport[1], &viewport[2], &viewport[3]) != 4) {
+                return false;
+            }
         } else {
-            std::cout << "Invalid input. Printing instructions again...\n\n";
+            return false;
         }
     }
+    return true;
 }
 
 
-void print_cycle (Grid **display_grid, int *frame_rate, std::mutex *mut) {
-    while (is_running) {
-        //if the menu is open, the condition waits until the menu returns to game
-        if(is_menu_active) {
-            std::unique_lock ulock(sig_mut);
-            ready_cond.wait(ulock);
-        }
+int convert(int argc, char *argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage:\np3 convert <in_pattern> <out_pattern>\n";
+        return 1;
+    }
+    try {
+        Rule rule;
+        Grid *grid = load_pattern(argv[2], &rule);
+        save_pattern(argv[3], *grid, rule);
+        delete grid;
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+
+int worker(int argc, char *argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage:\np3 worker <ip> <port>\n";
+        return 1;
+    }
+    try {
+        run_worker(parse_ip(argv[2]), parse_port(argv[3]));
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
 
-        //if the game is terminated in the menu, wait until update sends condition and return to end the process
-        if(is_terminated) {
-            std::unique_lock ulock(*mut);
-            terminate_cond.wait(ulock);
-            return;
+int run_distributed(Grid *grid, const Rule& rule, long generation, const Options& options) {
+    if (options.workers > grid->get_height()) {
+        std::cerr << "Cannot split " << grid->get_height() << " rows across " << options.workers << " workers\n";
+        return 1;
+    }
+    try {
+        if (options.generations > generation) {
+            coordinate(*grid, rule, options.generations - generation, options.workers);
+            generation = options.generations;
         }
+        std::cout << "Reached generation " << generation << "\n";
+        if (!options.output_path.empty()) {
+            save_pattern(options.output_path, *grid, rule);
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
+
 
-        //prints INDEPENDENT of the update
-        mut->lock();
-        if (!is_menu_active) {
-            (*display_grid)->print();
+void wait_for_command(int milliseconds) {
+    std::unique_lock lock(wake_mut);
+    wake_cond.wait_for(lock, std::chrono::milliseconds(milliseconds));
+}
+
+
+void wake_threads() {
+    {
+        std::lock_guard lock(wake_mut);
+    }
+    wake_cond.notify_all();
+}
+
+
+std::string set_rate(std::atomic<int> *rate, int value, std::string name) {
+    if (value < 1) {
+        return name + " cannot go below 1.";
+    }
+    *rate = value;
+    wake_threads();
+    return name + " is now " + std::to_string(value) + ".";
+}
+
+
+std::string handle_command(const std::string& line) {
+    std::istringstream words(line);
+    std::string command;
+    std::string argument;
+    words >> command >> argument;
+    for (char& c : command) {
+        c = std::tolower((unsigned char) c);
+    }
+
+    if (command.empty()) {
+        return "";
+    } else if (command == "q" || command == "quit") {
+        is_running = false;
+        wake_threads();
+        return "Quitting.";
+    } else if (command == "p" || command == "pause") {
+        is_paused = true;
+        return "Paused.";
+    } else if (command == "r" || command == "resume") {
+        steps_requested = 0;
+        is_paused = false;
+        wake_threads();
+        return "Resumed.";
+    } else if (command == "n" || command == "step") {
+        //stepping pauses the run, then computes the generations asked for as fast as possible
+        long count = argument.empty() ? 1 : atol(argument.c_str());
+        if (count <= 0) {
+            return "Usage: step [generations]";
         }
-        mut->unlock();
+        is_paused = true;
+        steps_requested += count;
+        wake_threads();
+        return "Stepping " + std::to_string(count) + " generation" + (count == 1 ? "." : "s.");
+    } else if (command == "s+" || command == "s-" || command == "sim") {
+        int value = (command == "s+") ? sim_rate + 1 : (command == "s-") ? sim_rate - 1 : atoi(argument.c_str());
+        return set_rate(&sim_rate, value, "Simulation rate");
+    } else if (command == "d+" || command == "d-" || command == "fps") {
+        int value = (command == "d+") ? frame_rate + 1 : (command == "d-") ? frame_rate - 1 : atoi(argument.c_str());
+        return set_rate(&frame_rate, value, "Frame rate");
+    } else if (command == "o" || command == "overlay") {
+        //statistics under the board on/off
+        show_overlay = argument.empty() ? !show_overlay : (argument == "on");
+        return std::string("Statistics overlay is now ") + (show_overlay ? "on." : "off.");
+    } else if (command == "stats") {
+        std::lock_guard lock(latest_mut);
+        return describe_summary(latest_generation, latest_summary) + (is_paused ? "  (paused)" : "");
+    } else if (command == "help" || command == "?") {
+        return "Commands: pause, resume, step [n], sim <rate>, fps <rate>, overlay [on|off], stats, quit";
+    }
+    return "Unknown command '" + command + "'; try help.";
+}
 
-        //sleep for 1/frame_rate seconds
-        int sleep_duration_ms = 1000 / *frame_rate;
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_duration_ms));
+
+void show_reply(const std::string& reply) {
+    {
+        std::lock_guard lock(latest_mut);
+        terminal_message = reply;
     }
+    needs_redraw = true;
+    wake_threads();
 }
 
 
-void update_row (Grid *working_grid, Grid *display_grid, int y) {
-    for (int x = 0; x < display_grid->get_width(); x++) {
-        working_grid->update_tile(*display_grid, x, y);
+void control_cycle (ControlChannel *channel) {
+    while (is_running) {
+        channel->poll_commands(100);
     }
 }
 
 
-void update_grid (Grid **working_grid, Grid **display_grid, int *sim_rate, std::mutex *mut) {
+void print_cycle (TripleBuffer *frames, Renderer *renderer) {
     while (is_running) {
-        //if the menu is open, the condition waits until the menu returns to game
-        if(is_menu_active) {
-            std::unique_lock ulock(sig_mut);
-            ready_cond.wait(ulock);
+        //a typed command has written over the screen, so the next frame is drawn in full
+        if (needs_redraw.exchange(false)) {
+            renderer->invalidate();
         }
 
-        //if the game is terminated in the menu, notify menu and print thread to deallocate and return and return to end the process
-        if(is_terminated) {
-            terminate_cond.notify_all();
-            return;
+        //takes the latest complete generation INDEPENDENT of the update. the update
+        //thread keeps publishing while this one is busy writing to the terminal
+        long generation;
+        StepSummary summary;
+        Grid *grid = frames->read(&generation, &summary);
+        std::string status = show_overlay ? describe_summary(generation, summary) : "";
+        if (is_paused) {
+            status += status.empty() ? "[paused]" : "  [paused]";
+        }
+        {
+            std::lock_guard lock(latest_mut);
+            if (!terminal_message.empty()) {
+                status += (status.empty() ? "" : "  |  ") + terminal_message;
+            }
         }
+        renderer->set_status(status);
+        std::cout << renderer->render(*grid);
+        std::cout.flush();
 
-        //store threads
-        std::vector<std::thread> threads;
+        //sleep for 1/frame_rate seconds
+        wait_for_command(1000 / frame_rate);
+    }
+}
+
+
+void update_grid (Grid **working_grid, Grid **display_grid, TripleBuffer *frames, Rule *rule,
+                  long generation, Stepper *stepper, Checkpointer *checkpointer, CycleDetector *detector,
+                  StatsWriter *stats) {
+    bool settled = false;
+    //the rule is fixed for the run, so the kernel is chosen once
+    StepFunction step = select_kernel(*rule);
+    while (is_running) {
+        //while paused, only the generations asked for by the step command are computed
+        bool stepping = false;
+        if (is_paused) {
+            if (steps_requested <= 0) {
+                wait_for_command(100);
+                continue;
+            }
+            steps_requested--;
+            stepping = true;
+        }
+
+        //a settled board no longer changes, so there is nothing left to compute
+        if (settled) {
+            if (!stepping) {
+                wait_for_command(100);
+            }
+            continue;
+        }
+
+        //update the working grid in strips, one per stepper thread, returning once all are done
+        StepSummary summary = stepper->step(step, **display_grid, **working_grid, *rule);
+
+        //swap the display and working grids. both are private to this thread, so no lock is needed
+        Grid *temp = *display_grid;
+        *display_grid = *working_grid;
+        *working_grid = temp;
 
-        //create threads to update each row of the grid
-        for (int y = 0; y < (*display_grid)->get_height(); y++) {
-            threads.push_back(std::thread (update_row, *working_grid, *display_grid, y));
+        //hand a copy of the new generation to the print thread
+        generation++;
+        frames->write_slot()->copy_from(**display_grid);
+        frames->publish(generation, summary);
+        {
+            std::lock_guard lock(latest_mut);
+            latest_generation = generation;
+            latest_summary = summary;
+        }
+        if (checkpointer != nullptr) {
+            checkpointer->on_generation(**display_grid, generation);
+        }
+        if (stats != nullptr) {
+            stats->write(generation, summary);
+        }
+        if (detector != nullptr && detector->record(summary.hash, generation)) {
+            settled = true;
+            std::cerr << "Settled at generation " << detector->get_settled() << " with period "
+                      << detector->get_period() << "\n";
         }
 
-        //join all threads before returning
-        for (int i = 0; i < threads.size(); i++) {
-            threads[i].join();
+        //sleep for 1/sim_rate seconds, unless stepping
+        if (!stepping) {
+            wait_for_command(1000 / sim_rate);
         }
+    }
+}
+
+int run_batch (Grid **working_grid, Grid **display_grid, Rule *rule, long generation, long target,
+               Stepper *stepper, Checkpointer *checkpointer, CycleDetector *detector, StatsWriter *stats,
+               int block_generations) {
+    StepFunction step = select_kernel(*rule);
+    BlockFunction block = select_block_kernel(*rule);
+    //stats are written for every generation, so there is nothing to block over
+    if (stats != nullptr) {
+        block_generations = 1;
+    }
 
-        //swap the display and working grids INDEPENDENT of the print
-        mut->lock();
+    //advances the display grid by the input number of generations and returns the summary of the last one
+    auto advance = [&](int generations) {
+        StepSummary summary = (generations == 1)
+                            ? stepper->step(step, **display_grid, **working_grid, *rule)
+                            : stepper->step(block, **display_grid, **working_grid, *rule, generations);
         Grid *temp = *display_grid;
         *display_grid = *working_grid;
         *working_grid = temp;
-        mut->unlock();
+        generation += generations;
 
-        //sleep for 1/sim_rate seconds
-        int sleep_duration_ms = 1000 / *sim_rate;
-        std::this_thread::sleep_for(std::chrono::milliseconds(sleep_duration_ms));
+        if (checkpointer != nullptr) {
+            checkpointer->on_generation(**display_grid, generation);
+        }
+        if (stats != nullptr) {
+            stats->write(generation, summary);
+        }
+        return summary;
+    };
+
+    bool settled = false;
+    while (generation < target) {
+        //blocks stop short of the target and of every checkpoint
+        long generations = std::min((long) block_generations, target - generation);
+        if (checkpointer != nullptr) {
+            long interval = checkpointer->get_interval();
+            generations = std::min(generations, interval - generation % interval);
+        }
+        StepSummary summary = advance(generations);
+
+        //once settled, the target generation matches the generation a whole number of periods before it,
+        //so only the remainder of the periods left needs computing
+        if (!settled && detector != nullptr && detector->record(summary.hash, generation)) {
+            settled = true;
+            long period = detector->get_period();
+            //blocked runs only see some generations, so the repeat found may span several periods. stepping
+            //one generation at a time until the state comes round again gives the exact period
+            if (block_generations > 1) {
+                long start = generation;
+                uint64_t hash = summary.hash;
+                while (generation - start < period && generation < target) {
+                    if (advance(1).hash == hash) {
+                        period = generation - start;
+                        break;
+                    }
+                }
+            }
+            std::cout << "Settled " << (block_generations > 1 ? "by" : "at") << " generation "
+                      << detector->get_settled() << " with period " << period
+                      << (period == 1 ? " (still life)" : "") << "\n";
+            long skipped = (target - generation) / period * period;
+            if (skipped > 0) {
+                std::cout << "Fast-forwarding " << skipped << " generations\n";
+                generation += skipped;
+            }
+        }
+    }
+    if (!settled) {
+        std::cout << "No cycle found by generation " << generation << "\n";
     }
-    delete *display_grid;
-    delete *working_grid;
-}
\ No newline at end of file
+    std::cout << "Reached generation " << generation << "\n";
+    return 0;
+}
@@ -0,0 +1,529 @@
+#include "patterns.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <memory>
+#include <vector>
+#include <array>
+#include <map>
+#include <cstring>
+#include <climits>
+#include <cctype>
+
+// Reads characters from a stream a large block at a time,
+// which is far cheaper than extracting them one by one
+class ChunkReader {
+    std::istream&     in;
+    std::vector<char> buffer;
+    size_t            pos;
+    size_t            end;
+
+    public:
+
+    ChunkReader(std::istream& in)
+        : in(in)
+        , buffer(1 << 16)
+        , pos(0)
+        , end(0)
+    {}
+
+    // Returns the next character, or -1 at the end of input
+    int next(){
+        if( pos == end ){
+            in.read(buffer.data(), buffer.size());
+            end = in.gcount();
+            pos = 0;
+            if( end == 0 ){
+                return -1;
+            }
+        }
+        return (unsigned char) buffer[pos++];
+    }
+
+    // Reads up to the next newline into line, returning false
+    // if there was nothing left to read
+    bool line(std::string& line){
+        line.clear();
+        int c = next();
+        if( c == -1 ){
+            return false;
+        }
+        while( c != -1 && c != '\n' ){
+            if( c != '\r' ){
+                line += (char) c;
+            }
+            c = next();
+        }
+        return true;
+    }
+};
+
+// Returns the input text without leading/trailing whitespace
+static std::string trim(std::string text){
+    size_t start = text.find_first_not_of(" \t\r\n");
+    if( start == std::string::npos ){
+        return "";
+    }
+    size_t end = text.find_last_not_of(" \t\r\n");
+    return text.substr(start, end - start + 1);
+}
+
+// Returns the lower-cased extension of a file name, or an
+// empty string if it has none
+static std::string extension(std::string file_name){
+    size_t dot   = file_name.rfind('.');
+    size_t slash = file_name.rfind('/');
+    if( dot == std::string::npos || (slash != std::string::npos && dot < slash) ){
+        return "";
+    }
+    std::string ext = file_name.substr(dot+1);
+    for(char& c : ext){
+        c = std::tolower((unsigned char) c);
+    }
+    return ext;
+}
+
+// Stores a rule read from a pattern file, if asked to
+static void read_rule(std::string text, Rule *rule){
+    if( rule == nullptr ){
+        return;
+    }
+    if( !Rule::parse(trim(text), *rule) ){
+        throw std::runtime_error("Unsupported rule '" + trim(text) + "' in pattern file.");
+    }
+}
+
+// Throws unless a grid of the input dimensions can be held
+// in a single buffer
+static void check_dimensions(long long width, long long height){
+    if( width <= 0 || height <= 0 ){
+        throw std::runtime_error("Pattern dimensions must be positive.");
+    }
+    if( (width + 1) * height > INT_MAX ){
+        throw std::runtime_error("Pattern is too large to load into a grid.");
+    }
+}
+
+// Returns a newly allocated grid sized by the RLE header
+// and filled while reading the runs
+Grid *load_rle(std::istream& in, Rule *rule){
+    ChunkReader reader(in);
+    std::string line;
+
+    // Skip '#' comment lines up to the "x = m, y = n" header
+    bool found = false;
+    while( reader.line(line) ){
+        line = trim(line);
+        if( !line.empty() && line[0] != '#' ){
+            found = true;
+            break;
+        }
+    }
+    if( !found ){
+        throw std::runtime_error("RLE file has no header line.");
+    }
+
+    long long width  = -1;
+    long long height = -1;
+    std::stringstream fields(line);
+    std::string field;
+    while( std::getline(fields, field, ',') ){
+        size_t equals = field.find('=');
+        if( equals == std::string::npos ){
+            throw std::runtime_error("Malformed RLE header.");
+        }
+        std::string key   = trim(field.substr(0, equals));
+        std::string value = trim(field.substr(equals+1));
+        if( key == "x" ){
+            width  = std::atoll(value.c_str());
+        } else if( key == "y" ){
+            height = std::atoll(value.c_str());
+        } else if( key == "rule" ){
+            read_rule(value, rule);
+        }
+    }
+    check_dimensions(width, height);
+    std::unique_ptr<Grid> grid(new Grid(width, height));
+
+    // Runs are an optional count followed by a tag:
+    // 'b' dead, '$' end of row, '!' end of pattern, and any
+    // other letter (or 'o') alive
+    long long x = 0;
+    long long y = 0;
+    long long count = 0;
+    int c;
+    while( (c = reader.next()) != -1 ){
+        if( c >= '0' && c <= '9' ){
+            count = count * 10 + (c - '0');
+            if( count > INT_MAX ){
+                throw std::runtime_error("RLE run length is too large.");
+            }
+            continue;
+        }
+        if( std::isspace(c) ){
+            continue;
+        }
+        long long run = (count > 0) ? count : 1;
+        count = 0;
+        if( c == '!' ){
+            break;
+        } else if( c == '$' ){
+            y += run;
+            x  = 0;
+        } else if( c == 'b' || c == '.' ){
+            x += run;
+        } else if( std::isalpha(c) ){
+            if( y >= height || x + run > width ){
+                throw std::runtime_error("RLE pattern exceeds the size in its header.");
+            }
+            std::memset(grid->row(y) + x, '#', run);
+            x += run;
+        } else {
+            throw std::runtime_error(std::string("Unexpected '") + (char) c + "' in RLE data.");
+        }
+    }
+    return grid.release();
+}
+
+// A node of a Macrocell quadtree. Leaves (level 3) are 8x8
+// bitmaps with bit (8*row + column) set for live tiles;
+// other nodes refer to their four quadrants by index, with
+// index 0 meaning an empty quadrant.
+struct MacrocellNode {
+    int      level;
+    int      child[4];
+    uint64_t bits;
+};
+
+// Bounding box of the live tiles of a node, relative to the
+// node's top-left corner
+struct Bounds {
+    bool      empty;
+    long long min_x, min_y, max_x, max_y;
+};
+
+// Returns the bounds of node 'index', memoized so shared
+// subtrees are only measured once
+static Bounds node_bounds(std::vector<MacrocellNode>& nodes, std::vector<Bounds>& memo, std::vector<bool>& done, int index){
+    if( index == 0 ){
+        return { true, 0, 0, 0, 0 };
+    }
+    if( done[index] ){
+        return memo[index];
+    }
+
+    MacrocellNode& node = nodes[index];
+    Bounds result = { true, LLONG_MAX, LLONG_MAX, LLONG_MIN, LLONG_MIN };
+    auto include = [&](Bounds b, long long dx, long long dy){
+        if( b.empty ){
+            return;
+        }
+        result.empty = false;
+        result.min_x = std::min(result.min_x, b.min_x + dx);
+        result.min_y = std::min(result.min_y, b.min_y + dy);
+        result.max_x = std::max(result.max_x, b.max_x + dx);
+        result.max_y = std::max(result.max_y, b.max_y + dy);
+    };
+
+    if( node.level == 3 ){
+        for(int bit=0; bit<64; bit++){
+            if( (node.bits >> bit) & 1 ){
+                include({ false, 0, 0, 0, 0 }, bit % 8, bit / 8);
+            }
+        }
+    } else {
+        long long half = 1LL << (node.level - 1);
+        for(int q=0; q<4; q++){
+            include(node_bounds(nodes, memo, done, node.child[q]), (q % 2) * half, (q / 2) * half);
+        }
+    }
+    memo[index] = result;
+    done[index] = true;
+    return result;
+}
+
+// Sets the live tiles of node 'index' in the grid, with the
+// node's top-left corner at (x,y) in grid coordinates
+static void rasterize(std::vector<MacrocellNode>& nodes, Grid& grid, int index, long long x, long long y){
+    if( index == 0 ){
+        return;
+    }
+    MacrocellNode& node = nodes[index];
+    long long size = 1LL << node.level;
+    if( x >= grid.get_width() || y >= grid.get_height() || x + size <= 0 || y + size <= 0 ){
+        return;
+    }
+    if( node.level == 3 ){
+        for(int bit=0; bit<64; bit++){
+            if( (node.bits >> bit) & 1 ){
+                grid.set_tile(x + bit % 8, y + bit / 8, true);
+            }
+        }
+        return;
+    }
+    long long half = size / 2;
+    for(int q=0; q<4; q++){
+        rasterize(nodes, grid, node.child[q], x + (q % 2) * half, y + (q / 2) * half);
+    }
+}
+
+// Returns a newly allocated grid just large enough for the
+// live tiles of a Macrocell quadtree
+Grid *load_macrocell(std::istream& in, Rule *rule){
+    ChunkReader reader(in);
+    std::string line;
+    if( !reader.line(line) || line.compare(0, 4, "[M2]") != 0 ){
+        throw std::runtime_error("Macrocell file must start with [M2].");
+    }
+
+    // Index 0 stands for an empty node, so real nodes start
+    // at 1 as they do in the file
+    std::vector<MacrocellNode> nodes(1);
+    while( reader.line(line) ){
+        if( line.empty() ){
+            continue;
+        }
+        if( line[0] == '#' ){
+            if( line.size() > 1 && line[1] == 'R' ){
+                read_rule(line.substr(2), rule);
+            }
+            continue;
+        }
+
+        MacrocellNode node = { 3, {0,0,0,0}, 0 };
+        if( line[0] == '.' || line[0] == '*' || line[0] == '$' ){
+            // Leaf rows end with '$', dropping trailing dead tiles
+            int row = 0;
+            int col = 0;
+            for(char c : line){
+                if( c == '$' ){
+                    row++;
+                    col = 0;
+                    continue;
+                }
+                if( row >= 8 || col >= 8 || (c != '.' && c != '*') ){
+                    throw std::runtime_error("Malformed Macrocell leaf.");
+                }
+                if( c == '*' ){
+                    node.bits |= 1ULL << (row * 8 + col);
+                }
+                col++;
+            }
+        } else {
+            std::stringstream fields(line);
+            if( !(fields >> node.level >> node.child[0] >> node.child[1] >> node.child[2] >> node.child[3]) ){
+                throw std::runtime_error("Malformed Macrocell node.");
+            }
+            // Levels 1 and 2 only appear in multi-state files
+            if( node.level < 4 || node.level > 62 ){
+                throw std::runtime_error("Unsupported Macrocell node level.");
+            }
+            for(int q=0; q<4; q++){
+                int child = node.child[q];
+                if( child < 0 || child >= (int) nodes.size() ||
+                    (child != 0 && nodes[child].level != node.level - 1) ){
+                    throw std::runtime_error("Macrocell node refers to an invalid child.");
+                }
+            }
+        }
+        nodes.push_back(node);
+    }
+    if( nodes.size() == 1 ){
+        throw std::runtime_error("Macrocell file has no nodes.");
+    }
+
+    // The last node is the root. Size the grid to the live
+    // tiles rather than the root, which may be enormous.
+    int root = nodes.size() - 1;
+    std::vector<Bounds> memo(nodes.size());
+    std::vector<bool>   done(nodes.size(), false);
+    Bounds bounds = node_bounds(nodes, memo, done, root);
+    if( bounds.empty ){
+        return new Grid(1,1);
+    }
+    long long width  = bounds.max_x - bounds.min_x + 1;
+    long long height = bounds.max_y - bounds.min_y + 1;
+    check_dimensions(width, height);
+
+    std::unique_ptr<Grid> grid(new Grid(width, height));
+    rasterize(nodes, *grid, root, -bounds.min_x, -bounds.min_y);
+    return grid.release();
+}
+
+// Writes the grid as RLE, keeping its full dimensions
+void write_rle(Grid& grid, const Rule& rule, std::ostream& out){
+    int width  = grid.get_width();
+    int height = grid.get_height();
+    out << "x = " << width << ", y = " << height << ", rule = " << rule.to_string() << "\n";
+
+    // Lines of run data are kept under 70 characters
+    size_t line_length = 0;
+    auto emit = [&](long long run, char tag){
+        std::string token = (run > 1) ? std::to_string(run) + tag : std::string(1, tag);
+        if( line_length + token.size() > 70 ){
+            out << '\n';
+            line_length = 0;
+        }
+        out << token;
+        line_length += token.size();
+    };
+
+    // Row ends are held back so blank rows merge into one
+    // run and trailing ones are dropped
+    long long pending_rows = 0;
+    for(int y=0; y<height; y++){
+        const char *row = grid.row(y);
+        int last = width - 1;
+        while( last >= 0 && row[last] != '#' ){
+            last--;
+        }
+        if( last < 0 ){
+            pending_rows++;
+            continue;
+        }
+        if( pending_rows > 0 ){
+            emit(pending_rows, '$');
+        }
+        int x = 0;
+        while( x <= last ){
+            char tile = row[x];
+            int  run  = 1;
+            while( x + run <= last && row[x + run] == tile ){
+                run++;
+            }
+            emit(run, (tile == '#') ? 'o' : 'b');
+            x += run;
+        }
+        pending_rows = 1;
+    }
+    emit(1, '!');
+    out << '\n';
+}
+
+// Builds the quadtree of the 2^level square at (x,y) for
+// write_macrocell, writing each distinct node the first
+// time it is seen. Returns the node's index.
+static int write_node(Grid& grid, std::ostream& out, int level, long long x, long long y,
+                      std::map<uint64_t,int>& leaves, std::map<std::array<int,5>,int>& inner, int& next_index){
+    if( x >= grid.get_width() || y >= grid.get_height() ){
+        return 0;
+    }
+
+    if( level == 3 ){
+        uint64_t bits = 0;
+        for(int row=0; row<8; row++){
+            for(int col=0; col<8; col++){
+                if( grid.exists(x+col, y+row) && grid.get_tile(x+col, y+row) ){
+                    bits |= 1ULL << (row * 8 + col);
+                }
+            }
+        }
+        if( bits == 0 ){
+            return 0;
+        }
+        auto found = leaves.find(bits);
+        if( found != leaves.end() ){
+            return found->second;
+        }
+
+        // Each row ends with '$' after its last live tile;
+        // rows after the last live one are left out
+        std::string text;
+        int last_row = 7;
+        while( ((bits >> (last_row * 8)) & 0xFF) == 0 ){
+            last_row--;
+        }
+        for(int row=0; row<=last_row; row++){
+            uint64_t row_bits = (bits >> (row * 8)) & 0xFF;
+            for(int col=0; row_bits >> col; col++){
+                text += ((row_bits >> col) & 1) ? '*' : '.';
+            }
+            text += '$';
+        }
+        out << text << '\n';
+        leaves[bits] = next_index;
+        return next_index++;
+    }
+
+    long long half = 1LL << (level - 1);
+    std::array<int,5> key = { level, 0, 0, 0, 0 };
+    for(int q=0; q<4; q++){
+        key[q+1] = write_node(grid, out, level-1, x + (q % 2) * half, y + (q / 2) * half, leaves, inner, next_index);
+    }
+    if( key[1] == 0 && key[2] == 0 && key[3] == 0 && key[4] == 0 ){
+        return 0;
+    }
+    auto found = inner.find(key);
+    if( found != inner.end() ){
+        return found->second;
+    }
+    out << level << ' ' << key[1] << ' ' << key[2] << ' ' << key[3] << ' ' << key[4] << '\n';
+    inner[key] = next_index;
+    return next_index++;
+}
+
+// Writes the grid as a Macrocell quadtree, sharing every
+// repeated subtree
+void write_macrocell(Grid& grid, const Rule& rule, std::ostream& out){
+    out << "[M2] (p3)\n";
+    out << "#R " << rule.to_string() << '\n';
+
+    // The root is the smallest square of at least one leaf
+    // that covers the grid
+    int level = 3;
+    while( (1LL << level) < grid.get_width() || (1LL << level) < grid.get_height() ){
+        level++;
+    }
+
+    std::map<uint64_t,int>          leaves;
+    std::map<std::array<int,5>,int> inner;
+    int next_index = 1;
+    // Children are always written before their parents, so
+    // the root comes last as the format requires
+    if( write_node(grid, out, level, 0, 0, leaves, inner, next_index) == 0 ){
+        // An empty universe is a single empty leaf
+        out << "$\n";
+    }
+}
+
+// Returns a newly allocated grid holding the pattern in the
+// input file. If the file names a rule and rule is not
+// null, the rule is stored there.
+Grid *load_pattern(std::string file_name, Rule *rule){
+    std::ifstream file(file_name, std::ios::binary);
+    if( !file ){
+        throw std::runtime_error("Could not open pattern file '" + file_name + "'.");
+    }
+    std::string ext = extension(file_name);
+    if( ext == "rle" ){
+        return load_rle(file, rule);
+    } else if( ext == "mc" ){
+        return load_macrocell(file, rule);
+    }
+    file.close();
+    return new Grid(file_name);
+}
+
+// Writes the grid to the input file in the format implied
+// by its extension, recording the rule where the format
+// allows it
+void save_pattern(std::string file_name, Grid& grid, const Rule& rule){
+    std::ofstream file(file_name, std::ios::binary);
+    if( !file ){
+        throw std::runtime_error("Could not create pattern file '" + file_name + "'.");
+    }
+    std::string ext = extension(file_name);
+    if( ext == "rle" ){
+        write_rle(grid, rule, file);
+    } else if( ext == "mc" ){
+        write_macrocell(grid, rule, file);
+    } else {
+        // Rows are stored with their newline, ready to write
+        for(int y=0; y<grid.get_height(); y++){
+            file.write(grid.row(y), grid.get_width() + 1);
+        }
+    }
+    if( !file ){
+        throw std::runtime_error("Failed to write pattern file '" + file_name + "'.");
+    }
+}
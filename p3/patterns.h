@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <iostream>
+#include "grid.h"
+#include "rule.h"
+
+// Pattern files are recognized by extension:
+//  - .rle : run length encoded Life patterns
+//  - .mc  : Macrocell quadtrees (two-state only)
+//  - anything else : plain text, one row per line, with
+//    non-space characters counted as 'alive'
+// Loaders throw a runtime exception if a file cannot be
+// opened or is malformed.
+
+// Returns a newly allocated grid holding the pattern in the
+// input file. If the file names a rule and rule is not
+// null, the rule is stored there.
+Grid *load_pattern(std::string file_name, Rule *rule);
+
+// Writes the grid to the input file in the format implied
+// by its extension, recording the rule where the format
+// allows it
+void save_pattern(std::string file_name, Grid& grid, const Rule& rule);
+
+// Returns a newly allocated grid sized by the RLE header
+// and filled while reading the runs
+Grid *load_rle(std::istream& in, Rule *rule);
+
+// Returns a newly allocated grid just large enough for the
+// live tiles of a Macrocell quadtree
+Grid *load_macrocell(std::istream& in, Rule *rule);
+
+// Writes the grid as RLE, keeping its full dimensions
+void write_rle(Grid& grid, const Rule& rule, std::ostream& out);
+
+// Writes the grid as a Macrocell quadtree, sharing every
+// repeated subtree
+void write_macrocell(Grid& grid, const Rule& rule, std::ostream& out);
@@ -0,0 +1,250 @@
+#include "renderer.h"
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <algorithm>
+
+// Glyph bit set for the tile at (dx,dy) within a glyph,
+// indexed [dy][dx]. Braille dots are numbered column-major
+// for the top three rows, with the fourth row added later
+// to the standard, hence the irregular ordering.
+static const uint8_t FULL_BITS[4][2]    = { {0x01,0}, {0,0}, {0,0}, {0,0} };
+static const uint8_t HALF_BITS[4][2]    = { {0x01,0}, {0x02,0}, {0,0}, {0,0} };
+static const uint8_t BRAILLE_BITS[4][2] = { {0x01,0x08}, {0x02,0x10}, {0x04,0x20}, {0x40,0x80} };
+
+// Glyph runs separated by fewer unchanged glyphs than this
+// are sent as one run, since re-sending a few glyphs is
+// cheaper than another cursor movement sequence
+static const int MERGE_GAP = 4;
+
+// Constructor: Creates a renderer for the given scale and
+// viewport (x, y, width, height in tiles). Zero width or
+// height fits the viewport to the grid and terminal.
+Renderer::Renderer(Scale scale, int x, int y, int w, int h)
+    : requested(scale)
+    , scale(SCALE_FULL)
+    , req_x(x)
+    , req_y(y)
+    , req_w(w)
+    , req_h(h)
+    , view_x(0)
+    , view_y(0)
+    , view_w(0)
+    , view_h(0)
+    , cell_w(1)
+    , cell_h(1)
+    , cols(0)
+    , rows(0)
+    , full_redraw(true)
+{}
+
+// Parses a scale name ("auto", "full", "half", "braille").
+// Returns false if the name is not recognized.
+bool Renderer::parse_scale(std::string name, Scale& scale){
+    if( name == "auto" ){
+        scale = SCALE_AUTO;
+    } else if( name == "full" ){
+        scale = SCALE_FULL;
+    } else if( name == "half" ){
+        scale = SCALE_HALF;
+    } else if( name == "braille" ){
+        scale = SCALE_BRAILLE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Sets the text of the status line drawn below the frame
+// (empty to leave it blank)
+void Renderer::set_status(std::string text){
+    status = text;
+}
+
+// Forces the next call to render to clear the screen and
+// draw the whole frame, re-reading the terminal size
+void Renderer::invalidate(){
+    full_redraw = true;
+    cols = 0;
+}
+
+// Resolves the viewport and scale against the grid and
+// the current terminal size
+void Renderer::layout(Grid& grid){
+    // Ask the terminal for its size, falling back to the
+    // classic 80x24 when output is not a terminal
+    int term_cols = 80;
+    int term_rows = 24;
+    winsize ws;
+    if( ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 0 ){
+        term_cols = ws.ws_col;
+        term_rows = ws.ws_row;
+    }
+    // Keep the last two lines free for the status line and
+    // the cursor
+    term_rows = (term_rows > 2) ? term_rows - 2 : 1;
+
+    // Clip the requested viewport to the grid
+    view_x = (req_x < 0) ? 0 : req_x;
+    view_y = (req_y < 0) ? 0 : req_y;
+    if( view_x > grid.get_width() ){
+        view_x = grid.get_width();
+    }
+    if( view_y > grid.get_height() ){
+        view_y = grid.get_height();
+    }
+    view_w = grid.get_width()  - view_x;
+    view_h = grid.get_height() - view_y;
+    if( req_w > 0 && req_w < view_w ){
+        view_w = req_w;
+    }
+    if( req_h > 0 && req_h < view_h ){
+        view_h = req_h;
+    }
+
+    // Pick the smallest downsampling that fits, settling for
+    // braille (and clipping) when nothing does
+    scale = requested;
+    if( scale == SCALE_AUTO ){
+        if( view_w <= term_cols && view_h <= term_rows ){
+            scale = SCALE_FULL;
+        } else if( view_w <= term_cols && (view_h+1)/2 <= term_rows ){
+            scale = SCALE_HALF;
+        } else {
+            scale = SCALE_BRAILLE;
+        }
+    }
+    cell_w = (scale == SCALE_BRAILLE) ? 2 : 1;
+    cell_h = (scale == SCALE_BRAILLE) ? 4 : (scale == SCALE_HALF) ? 2 : 1;
+
+    // Glyph dimensions of the viewport, clipped to the terminal
+    cols = (view_w + cell_w - 1) / cell_w;
+    rows = (view_h + cell_h - 1) / cell_h;
+    if( cols > term_cols ){
+        cols = term_cols;
+        view_w = cols * cell_w;
+    }
+    if( rows > term_rows ){
+        rows = term_rows;
+        view_h = rows * cell_h;
+    }
+
+    current.assign(cols*rows, 0);
+    previous.assign(cols*rows, 0);
+    full_redraw = true;
+}
+
+// Fills 'current' with the glyph codes for the viewport
+void Renderer::compose(Grid& grid){
+    const uint8_t (*bits)[2] = (scale == SCALE_BRAILLE) ? BRAILLE_BITS
+                             : (scale == SCALE_HALF)    ? HALF_BITS
+                             :                            FULL_BITS;
+    std::fill(current.begin(), current.end(), 0);
+
+    int x_end = view_x + view_w;
+    int y_end = view_y + view_h;
+    if( x_end > grid.get_width() ){
+        x_end = grid.get_width();
+    }
+    if( y_end > grid.get_height() ){
+        y_end = grid.get_height();
+    }
+
+    // Walk the viewport one tile row at a time, or-ing each
+    // live tile's bit into the glyph that covers it
+    for(int y=view_y; y<y_end; y++){
+        int row = (y - view_y) / cell_h;
+        int dy  = (y - view_y) % cell_h;
+        uint8_t *glyphs = &current[row*cols];
+        for(int x=view_x; x<x_end; x++){
+            if( grid.get_tile(x,y) ){
+                int dx = (x - view_x) % cell_w;
+                glyphs[(x - view_x) / cell_w] |= bits[dy][dx];
+            }
+        }
+    }
+}
+
+// Appends the UTF-8 encoding of a glyph code to output
+void Renderer::append_glyph(std::string& output, uint8_t code){
+    if( code == 0 ){
+        output += ' ';
+        return;
+    }
+    int point;
+    if( scale == SCALE_FULL ){
+        output += '#';
+        return;
+    } else if( scale == SCALE_HALF ){
+        // Upper half, lower half, full block
+        point = (code == 0x01) ? 0x2580 : (code == 0x02) ? 0x2584 : 0x2588;
+    } else {
+        point = 0x2800 + code;
+    }
+    // All of the glyphs used lie in the three-byte range
+    output += (char) (0xE0 |  (point >> 12));
+    output += (char) (0x80 | ((point >> 6) & 0x3F));
+    output += (char) (0x80 |  (point & 0x3F));
+}
+
+// Returns the terminal output needed to bring the screen
+// from the previous frame to the state of the input grid.
+// The returned text leaves the cursor below the frame
+// and its status line.
+std::string Renderer::render(Grid& grid){
+    if( cols == 0 ){
+        layout(grid);
+    }
+    compose(grid);
+
+    std::string output;
+    if( full_redraw ){
+        // Clear the screen and home the cursor
+        output += "\x1b[2J\x1b[H";
+    }
+
+    for(int r=0; r<rows; r++){
+        const uint8_t *cur  = &current[r*cols];
+        const uint8_t *prev = &previous[r*cols];
+        int c = 0;
+        while( c < cols ){
+            // Skip glyphs which are already on screen
+            if( !full_redraw && cur[c] == prev[c] ){
+                c++;
+                continue;
+            }
+
+            // Extend the run over changed glyphs, absorbing
+            // short stretches of unchanged ones
+            int start = c;
+            int end   = c + 1;
+            int scan  = end;
+            while( scan < cols && scan - end < MERGE_GAP ){
+                if( full_redraw || cur[scan] != prev[scan] ){
+                    end = scan + 1;
+                }
+                scan++;
+            }
+
+            // Move the cursor (1-based row;column) and draw
+            output += "\x1b[" + std::to_string(r+1) + ";" + std::to_string(start+1) + "H";
+            for(int i=start; i<end; i++){
+                append_glyph(output, cur[i]);
+            }
+            c = end;
+        }
+    }
+
+    // Rewrite the status line, clearing what is left of the
+    // previous text
+    if( full_redraw || status != drawn_status ){
+        output += "\x1b[" + std::to_string(rows+1) + ";1H" + status + "\x1b[K";
+        drawn_status = status;
+    }
+
+    if( !output.empty() ){
+        output += "\x1b[" + std::to_string(rows+2) + ";1H";
+    }
+    previous.swap(current);
+    full_redraw = false;
+    return output;
+}
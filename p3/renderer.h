@@ -0,0 +1,91 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "grid.h"
+
+///////////////////////////////////////////////////////////
+// Draws frames of a Grid to an ANSI terminal. The last
+// displayed frame is kept so that only glyphs which have
+// changed are sent on later frames. Large grids can be
+// shown through a viewport and/or downsampled so that
+// each glyph covers several tiles.
+///////////////////////////////////////////////////////////
+class Renderer {
+
+    public:
+
+    // How many tiles are packed into a single glyph
+    //  - SCALE_FULL    : 1x1, drawn as '#' or ' '
+    //  - SCALE_HALF    : 1x2, drawn with half-block glyphs
+    //  - SCALE_BRAILLE : 2x4, drawn with braille glyphs
+    //  - SCALE_AUTO    : the smallest of the above that
+    //                    fits the viewport in the terminal
+    enum Scale { SCALE_AUTO, SCALE_FULL, SCALE_HALF, SCALE_BRAILLE };
+
+    private:
+
+    Scale requested;
+    Scale scale;
+
+    // Viewport, in tiles. A width or height of zero means
+    // "as much of the grid as possible".
+    int req_x, req_y, req_w, req_h;
+    int view_x, view_y, view_w, view_h;
+
+    // Tiles covered by each glyph, and the glyph dimensions
+    // of the drawn area
+    int cell_w, cell_h;
+    int cols, rows;
+
+    // Glyph codes of the frame being built and of the frame
+    // that is currently on the terminal
+    std::vector<uint8_t> current;
+    std::vector<uint8_t> previous;
+
+    // Set when the terminal no longer matches 'previous'
+    // (first frame, or after something else wrote to it)
+    bool full_redraw;
+
+    // Text for the status line below the frame, and the text
+    // currently shown there
+    std::string status;
+    std::string drawn_status;
+
+    // Resolves the viewport and scale against the grid and
+    // the current terminal size
+    void layout(Grid& grid);
+
+    // Fills 'current' with the glyph codes for the viewport
+    void compose(Grid& grid);
+
+    // Appends the UTF-8 encoding of a glyph code to output
+    void append_glyph(std::string& output, uint8_t code);
+
+    public:
+
+    // Constructor: Creates a renderer for the given scale and
+    // viewport (x, y, width, height in tiles). Zero width or
+    // height fits the viewport to the grid and terminal.
+    Renderer(Scale scale, int x, int y, int w, int h);
+
+    // Returns the terminal output needed to bring the screen
+    // from the previous frame to the state of the input grid.
+    // The returned text leaves the cursor below the frame
+    // and its status line.
+    std::string render(Grid& grid);
+
+    // Sets the text of the status line drawn below the frame
+    // (empty to leave it blank)
+    void set_status(std::string text);
+
+    // Forces the next call to render to clear the screen and
+    // draw the whole frame, re-reading the terminal size
+    void invalidate();
+
+    // Parses a scale name ("auto", "full", "half", "braille").
+    // Returns false if the name is not recognized.
+    static bool parse_scale(std::string name, Scale& scale);
+
+};
@@ -0,0 +1,93 @@
+#include "rule.h"
+#include <cctype>
+
+// Returns the birth mask
+uint16_t Rule::get_birth() const {
+    return birth;
+}
+
+// Returns the survival mask
+uint16_t Rule::get_survival() const {
+    return survival;
+}
+
+// Returns the 512-entry next state table
+const uint8_t *Rule::get_table() const {
+    return table;
+}
+
+// Returns the rule in B/S notation
+std::string Rule::to_string() const {
+    std::string text = "B";
+    for(int n=0; n<=8; n++){
+        if( (birth >> n) & 1 ){
+            text += (char) ('0' + n);
+        }
+    }
+    text += "/S";
+    for(int n=0; n<=8; n++){
+        if( (survival >> n) & 1 ){
+            text += (char) ('0' + n);
+        }
+    }
+    return text;
+}
+
+// Parses a rule in B/S notation ("B36/S23", case
+// insensitive, either order) or in the older S/B notation
+// without letters ("23/36"). Returns false and leaves
+// rule unchanged if the text is not a valid rule.
+bool Rule::parse(std::string text, Rule& rule){
+    size_t slash = text.find('/');
+    if( slash == std::string::npos || text.find('/', slash+1) != std::string::npos ){
+        return false;
+    }
+    std::string parts[2] = { text.substr(0,slash), text.substr(slash+1) };
+
+    uint16_t masks[2] = { 0, 0 };
+    bool     is_birth[2];
+    for(int i=0; i<2; i++){
+        std::string& part = parts[i];
+        // Without a leading letter, the old convention of
+        // survival first, then birth applies
+        size_t start = 0;
+        if( !part.empty() && std::isalpha((unsigned char) part[0]) ){
+            char letter = std::toupper((unsigned char) part[0]);
+            if( letter != 'B' && letter != 'S' ){
+                return false;
+            }
+            is_birth[i] = (letter == 'B');
+            start = 1;
+        } else {
+            is_birth[i] = (i == 1);
+        }
+        for(size_t j=start; j<part.size(); j++){
+            if( part[j] < '0' || part[j] > '8' ){
+                return false;
+            }
+            masks[i] |= 1 << (part[j] - '0');
+        }
+    }
+    if( is_birth[0] == is_birth[1] ){
+        return false;
+    }
+
+    rule = is_birth[0] ? Rule(masks[0], masks[1]) : Rule(masks[1], masks[0]);
+    return true;
+}
+
+// Constructor: Creates Conway's Game of Life (B3/S23)
+Rule::Rule()
+    : Rule(mask("3"), mask("23"))
+{}
+
+// Constructor: Creates the rule with the input masks
+// Precondition: only bits 0-8 may be set
+Rule::Rule(uint16_t birth, uint16_t survival)
+    : birth(birth)
+    , survival(survival)
+{
+    for(int index=0; index<512; index++){
+        table[index] = next_state(birth, survival, index);
+    }
+}
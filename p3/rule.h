@@ -0,0 +1,73 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////
+// A Life-like cellular automaton rule in B/S notation,
+// e.g. B3/S23 for Conway's Game of Life. Bit n of the
+// birth (survival) mask is set when a dead (live) tile
+// with n live neighbors is alive in the next generation.
+///////////////////////////////////////////////////////////
+class Rule {
+
+    uint16_t birth;
+    uint16_t survival;
+
+    // Next state for every 3x3 neighborhood. Bits 0-2 of the
+    // index are the left column (top to bottom), bits 3-5 the
+    // center column and bits 6-8 the right column, so the
+    // tile being updated is bit 4.
+    uint8_t table[512];
+
+    public:
+
+    // Returns the mask for a string of neighbor counts,
+    // e.g. "23" gives (1<<2)|(1<<3)
+    static constexpr uint16_t mask(const char *digits){
+        uint16_t result = 0;
+        for(; *digits != '\0'; digits++){
+            result |= 1 << (*digits - '0');
+        }
+        return result;
+    }
+
+    // Returns the next state of the center tile of the input
+    // neighborhood index under the input masks
+    static constexpr uint8_t next_state(uint16_t birth, uint16_t survival, int index){
+        int count = 0;
+        for(int bit=0; bit<9; bit++){
+            if( bit != 4 && (index >> bit) & 1 ){
+                count++;
+            }
+        }
+        uint16_t masks = ((index >> 4) & 1) ? survival : birth;
+        return (masks >> count) & 1;
+    }
+
+    // Returns the birth mask
+    uint16_t get_birth() const;
+
+    // Returns the survival mask
+    uint16_t get_survival() const;
+
+    // Returns the 512-entry next state table
+    const uint8_t *get_table() const;
+
+    // Returns the rule in B/S notation
+    std::string to_string() const;
+
+    // Parses a rule in B/S notation ("B36/S23", case
+    // insensitive, either order) or in the older S/B notation
+    // without letters ("23/36"). Returns false and leaves
+    // rule unchanged if the text is not a valid rule.
+    static bool parse(std::string text, Rule& rule);
+
+    // Constructor: Creates Conway's Game of Life (B3/S23)
+    Rule();
+
+    // Constructor: Creates the rule with the input masks
+    // Precondition: only bits 0-8 may be set
+    Rule(uint16_t birth, uint16_t survival);
+
+};
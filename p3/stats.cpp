@@ -0,0 +1,70 @@
+#include "stats.h"
+#include <stdexcept>
+
+// The file is flushed after this many generations, so a
+// reader following it sees progress without a write per
+// generation
+static const long FLUSH_INTERVAL = 64;
+
+// Appends the summary of the input generation
+void StatsWriter::write(long generation, const StepSummary& summary){
+    bool has_bounds = summary.population > 0;
+    if( json ){
+        out << "{\"generation\":" << generation
+            << ",\"population\":" << summary.population
+            << ",\"births\":"     << summary.births
+            << ",\"deaths\":"     << summary.deaths
+            << ",\"bbox\":";
+        if( has_bounds ){
+            out << '[' << summary.min_x << ',' << summary.min_y << ','
+                << summary.max_x << ',' << summary.max_y << ']';
+        } else {
+            out << "null";
+        }
+        out << "}\n";
+    } else {
+        out << generation << ',' << summary.population << ','
+            << summary.births << ',' << summary.deaths << ',';
+        // An empty board has no bounding box
+        if( has_bounds ){
+            out << summary.min_x << ',' << summary.min_y << ','
+                << summary.max_x << ',' << summary.max_y;
+        } else {
+            out << ",,,";
+        }
+        out << '\n';
+    }
+    if( generation % FLUSH_INTERVAL == 0 ){
+        out.flush();
+    }
+}
+
+// Constructor: Creates (or truncates) the output file and
+// writes the CSV header if needed. Throws a runtime
+// exception if the file cannot be created.
+StatsWriter::StatsWriter(std::string path)
+    : out(path)
+{
+    if( !out ){
+        throw std::runtime_error("Could not create stats file '" + path + "'.");
+    }
+    json = (path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0)
+        || (path.size() >= 6 && path.compare(path.size() - 6, 6, ".jsonl") == 0);
+    if( !json ){
+        out << "generation,population,births,deaths,min_x,min_y,max_x,max_y\n";
+    }
+}
+
+// Returns a one-line description of a generation's summary,
+// for the display overlay and the menu
+std::string describe_summary(long generation, const StepSummary& summary){
+    std::string text = "gen " + std::to_string(generation)
+                     + "  pop " + std::to_string(summary.population)
+                     + "  +" + std::to_string(summary.births)
+                     + " -" + std::to_string(summary.deaths);
+    if( summary.population > 0 ){
+        text += "  bbox (" + std::to_string(summary.min_x) + "," + std::to_string(summary.min_y)
+              + ")-(" + std::to_string(summary.max_x) + "," + std::to_string(summary.max_y) + ")";
+    }
+    return text;
+}
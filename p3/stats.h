@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <fstream>
+#include "kernel.h"
+
+///////////////////////////////////////////////////////////
+// Streams the per-generation summaries produced by the
+// update kernel to a file, as CSV or (for files ending in
+// .json or .jsonl) as one JSON object per line.
+///////////////////////////////////////////////////////////
+class StatsWriter {
+
+    std::ofstream out;
+    bool          json;
+
+    public:
+
+    // Appends the summary of the input generation
+    void write(long generation, const StepSummary& summary);
+
+    // Constructor: Creates (or truncates) the output file and
+    // writes the CSV header if needed. Throws a runtime
+    // exception if the file cannot be created.
+    StatsWriter(std::string path);
+
+};
+
+// Returns a one-line description of a generation's summary,
+// for the display overlay and the menu
+std::string describe_summary(long generation, const StepSummary& summary);
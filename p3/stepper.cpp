@@ -0,0 +1,133 @@
+#include "stepper.h"
+
+// Updates the strip of rows belonging to the input
+// thread index
+void Stepper::run_strip(int index){
+    int height  = src->get_height();
+    int y_begin = (long) height *  index      / thread_count;
+    int y_end   = (long) height * (index + 1) / thread_count;
+    if( block != nullptr ){
+        summaries[index] = block(*src, *dst, *rule, y_begin, y_end, generations);
+    } else {
+        summaries[index] = kernel(*src, *dst, *rule, y_begin, y_end);
+    }
+}
+
+// Body of each worker thread
+void Stepper::work(int index){
+    long seen = 0;
+    while( true ){
+        {
+            std::unique_lock lock(mut);
+            start_cond.wait(lock, [&]{ return stopping || round != seen; });
+            if( stopping ){
+                return;
+            }
+            seen = round;
+        }
+        run_strip(index);
+        {
+            std::lock_guard lock(mut);
+            remaining--;
+            if( remaining == 0 ){
+                done_cond.notify_one();
+            }
+        }
+    }
+}
+
+// Hands the current generation to the workers, runs the
+// last strip and returns the merged summary once every
+// strip is done
+StepSummary Stepper::run_round(){
+    {
+        std::lock_guard lock(mut);
+        remaining = thread_count - 1;
+        round++;
+    }
+    start_cond.notify_all();
+
+    // The calling thread takes the last strip
+    run_strip(thread_count - 1);
+
+    std::unique_lock lock(mut);
+    done_cond.wait(lock, [&]{ return remaining == 0; });
+    StepSummary total;
+    for(StepSummary& summary : summaries){
+        total.merge(summary);
+    }
+    return total;
+}
+
+// Writes the generation following src into dst, using
+// every thread, and returns once all strips are done with
+// the summary of the whole generation
+// Precondition: src and dst have the same dimensions
+StepSummary Stepper::step(StepFunction kernel, Grid& src, Grid& dst, const Rule& rule){
+    // Workers only read these after the lock in run_round
+    // hands them the round
+    this->kernel = kernel;
+    this->block  = nullptr;
+    this->src    = &src;
+    this->dst    = &dst;
+    this->rule   = &rule;
+    return run_round();
+}
+
+// Writes the generation 'generations' after src into dst
+// with a blocked kernel and returns its summary
+// Precondition: src and dst have the same dimensions and
+//               generations >= 1
+StepSummary Stepper::step(BlockFunction block, Grid& src, Grid& dst, const Rule& rule, int generations){
+    this->kernel      = nullptr;
+    this->block       = block;
+    this->generations = generations;
+    this->src         = &src;
+    this->dst         = &dst;
+    this->rule        = &rule;
+    return run_round();
+}
+
+// Returns the number of threads used per generation
+int Stepper::get_threads(){
+    return thread_count;
+}
+
+// Constructor: Starts threads-1 workers; the thread that
+// calls step does the last strip itself. Zero threads
+// means one per hardware thread.
+Stepper::Stepper(int threads)
+    : thread_count(threads)
+    , kernel(nullptr)
+    , block(nullptr)
+    , generations(1)
+    , src(nullptr)
+    , dst(nullptr)
+    , rule(nullptr)
+    , round(0)
+    , remaining(0)
+    , stopping(false)
+{
+    if( thread_count <= 0 ){
+        thread_count = std::thread::hardware_concurrency();
+    }
+    if( thread_count <= 0 ){
+        thread_count = 1;
+    }
+    summaries.resize(thread_count);
+    for(int i=0; i<thread_count-1; i++){
+        workers.push_back(std::thread(&Stepper::work, this, i));
+    }
+}
+
+// Destructor: stops and joins the workers
+Stepper::~Stepper(){
+    {
+        std::lock_guard lock(mut);
+        stopping = true;
+    }
+    start_cond.notify_all();
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include "grid.h"
+#include "rule.h"
+#include "kernel.h"
+
+///////////////////////////////////////////////////////////
+// Advances whole grids one generation at a time, splitting
+// the rows into one strip per thread. The worker threads
+// are started once and reused for every generation, since
+// starting threads costs more than updating a small grid.
+///////////////////////////////////////////////////////////
+class Stepper {
+
+    int                      thread_count;
+    std::vector<std::thread> workers;
+
+    // The generation being computed, read by the workers.
+    // Either kernel or block is set; block advances
+    // 'generations' generations at once.
+    StepFunction  kernel;
+    BlockFunction block;
+    int           generations;
+    Grid        *src;
+    Grid        *dst;
+    const Rule  *rule;
+
+    // Summary of each thread's strip
+    std::vector<StepSummary> summaries;
+
+    // Incremented for each generation, so workers can tell a
+    // new one from a spurious wake up
+    long                    round;
+    int                     remaining;
+    bool                    stopping;
+    std::mutex              mut;
+    std::condition_variable start_cond;
+    std::condition_variable done_cond;
+
+    // Updates the strip of rows belonging to the input
+    // thread index
+    void run_strip(int index);
+
+    // Hands the current generation to the workers, runs the
+    // last strip and returns the merged summary once every
+    // strip is done
+    StepSummary run_round();
+
+    // Body of each worker thread
+    void work(int index);
+
+    public:
+
+    // Writes the generation following src into dst, using
+    // every thread, and returns once all strips are done with
+    // the summary of the whole generation
+    // Precondition: src and dst have the same dimensions
+    StepSummary step(StepFunction kernel, Grid& src, Grid& dst, const Rule& rule);
+
+    // Writes the generation 'generations' after src into dst
+    // with a blocked kernel, which gives each thread's strip
+    // its own halo so threads only meet once at the end, and
+    // returns the summary of that generation
+    // Precondition: src and dst have the same dimensions and
+    //               generations >= 1
+    StepSummary step(BlockFunction block, Grid& src, Grid& dst, const Rule& rule, int generations);
+
+    // Returns the number of threads used per generation
+    int get_threads();
+
+    // Constructor: Starts threads-1 workers; the thread that
+    // calls step does the last strip itself. Zero threads
+    // means one per hardware thread.
+    Stepper(int threads);
+
+    // Destructor: stops and joins the workers
+    ~Stepper();
+
+};
@@ -0,0 +1,58 @@
+#include "triple_buffer.h"
+
+// Returns the grid the publisher should fill with the
+// next generation
+Grid *TripleBuffer::write_slot(){
+    return slots[back];
+}
+
+// Makes the filled write slot the latest generation and
+// gives the publisher a new slot to write into
+void TripleBuffer::publish(long generation, const StepSummary& summary){
+    generations[back] = generation;
+    summaries[back]   = summary;
+    // Release makes the slot's contents visible to the reader
+    // that acquires it. Whatever was in the middle, whether
+    // read or not, becomes the next slot to write.
+    int old = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+    back = old & INDEX_MASK;
+}
+
+// Returns the latest published generation, which stays
+// valid and unchanged until the next call to read. If
+// generation or summary are not null, they receive the
+// values passed to publish.
+Grid *TripleBuffer::read(long *generation, StepSummary *summary){
+    if( middle.load(std::memory_order_acquire) & FRESH ){
+        int old = middle.exchange(front, std::memory_order_acq_rel);
+        front = old & INDEX_MASK;
+    }
+    if( generation != nullptr ){
+        *generation = generations[front];
+    }
+    if( summary != nullptr ){
+        *summary = summaries[front];
+    }
+    return slots[front];
+}
+
+// Constructor: Creates three empty grids of the input
+// dimensions
+// Precondition: width and height must be positive
+TripleBuffer::TripleBuffer(int w, int h)
+    : back(0)
+    , front(1)
+    , middle(2)
+{
+    for(int i=0; i<3; i++){
+        slots[i] = new Grid(w,h);
+        generations[i] = 0;
+    }
+}
+
+// Destructor: frees the grids
+TripleBuffer::~TripleBuffer(){
+    for(int i=0; i<3; i++){
+        delete slots[i];
+    }
+}
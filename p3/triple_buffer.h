@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include "grid.h"
+#include "kernel.h"
+
+///////////////////////////////////////////////////////////
+// Hands completed generations from a single publisher
+// (the update thread) to a single reader (the print
+// thread) without locks. Three grids rotate between the
+// roles of 'back' (being written), 'middle' (latest
+// complete generation) and 'front' (being read). The
+// publisher never waits for the reader, and the reader
+// always sees a whole generation.
+///////////////////////////////////////////////////////////
+class TripleBuffer {
+
+    Grid       *slots[3];
+    long        generations[3];
+    StepSummary summaries[3];
+
+    // Slot indices owned by the publisher and reader
+    int back;
+    int front;
+
+    // Index of the middle slot, with FRESH set when it holds
+    // a generation the reader has not yet taken
+    std::atomic<int> middle;
+
+    static const int INDEX_MASK = 0x3;
+    static const int FRESH      = 0x4;
+
+    public:
+
+    // Returns the grid the publisher should fill with the
+    // next generation
+    Grid *write_slot();
+
+    // Makes the filled write slot the latest generation and
+    // gives the publisher a new slot to write into
+    void publish(long generation, const StepSummary& summary);
+
+    // Returns the latest published generation, which stays
+    // valid and unchanged until the next call to read. If
+    // generation or summary are not null, they receive the
+    // values passed to publish.
+    Grid *read(long *generation, StepSummary *summary);
+
+    // Constructor: Creates three empty grids of the input
+    // dimensions
+    // Precondition: width and height must be positive
+    TripleBuffer(int w, int h);
+
+    // Destructor: frees the grids
+    ~TripleBuffer();
+
+};
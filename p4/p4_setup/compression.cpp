@@ -0,0 +1,51 @@
+#include "compression.h"
+#include "protocol.h"
+#include "../../p1/rle.h"
+
+// Returns the codecs this build supports, best first, one
+// byte each, as a HELLO offers them
+std::string supported_codecs(){
+    return std::string(1, (char) CODEC_RLE);
+}
+
+// Returns the first codec in offered that this build
+// supports, or CODEC_NONE
+uint8_t choose_codec(const std::string& offered){
+    std::string supported = supported_codecs();
+    for(char codec : offered){
+        if( supported.find(codec) != std::string::npos ){
+            return codec;
+        }
+    }
+    return CODEC_NONE;
+}
+
+// Compresses size bytes of data with codec into output.
+// Returns false if codec is unknown or the result would
+// not be smaller than the input.
+bool compress(uint8_t codec, const char *data, size_t size, std::string& output){
+    output.clear();
+    if( size == 0 ){
+        return false;
+    }
+    switch( codec ){
+        case CODEC_RLE:
+            // Gives up as soon as it stops paying off
+            return rleCompress(data, size, output, size - 1);
+        default:
+            return false;
+    }
+}
+
+// Expands size bytes of data compressed with codec into
+// output. Returns false if codec is unknown, the data is
+// malformed, or it expands past limit bytes.
+bool decompress(uint8_t codec, const char *data, size_t size, std::string& output, size_t limit){
+    output.clear();
+    switch( codec ){
+        case CODEC_RLE:
+            return rleDecompress(data, size, output, limit);
+        default:
+            return false;
+    }
+}
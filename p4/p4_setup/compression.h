@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////
+// The codecs payloads can be compressed with on the wire
+// (see Codec in protocol.h). Each codec lives behind
+// compress() and decompress(), so adding one means adding
+// its id, a case to each, and offering it in
+// supported_codecs().
+//
+// Payloads smaller than a threshold aren't worth the work,
+// and one that doesn't come out smaller is sent as it is,
+// so incompressible data never grows.
+///////////////////////////////////////////////////////////
+
+// Payloads below this many bytes are sent as they are
+const size_t COMPRESS_MIN_SIZE = 1024;
+
+// Returns the codecs this build supports, best first, one
+// byte each, as a HELLO offers them
+std::string supported_codecs();
+
+// Returns the first codec in offered that this build
+// supports, or CODEC_NONE
+uint8_t choose_codec(const std::string& offered);
+
+// Compresses size bytes of data with codec into output.
+// Returns false if codec is unknown or the result would
+// not be smaller than the input.
+bool compress(uint8_t codec, const char *data, size_t size, std::string& output);
+
+// Expands size bytes of data compressed with codec into
+// output. Returns false if codec is unknown, the data is
+// malformed, or it expands past limit bytes.
+bool decompress(uint8_t codec, const char *data, size_t size, std::string& output, size_t limit);
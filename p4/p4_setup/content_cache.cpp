@@ -0,0 +1,92 @@
+#include "content_cache.h"
+#include "path_locks.h"
+
+// Returns true if the two describe the same version of
+// the same file
+static bool same_file(const struct stat& a, const struct stat& b){
+    return a.st_dev == b.st_dev && a.st_ino == b.st_ino && a.st_size == b.st_size &&
+           a.st_mtim.tv_sec == b.st_mtim.tv_sec && a.st_mtim.tv_nsec == b.st_mtim.tv_nsec &&
+           a.st_ctim.tv_sec == b.st_ctim.tv_sec && a.st_ctim.tv_nsec == b.st_ctim.tv_nsec;
+}
+
+// Drops least recently used entries until used is at most
+// limit
+void ContentCache::evict(size_t limit){
+    while( used > limit && !entries.empty() ){
+        used -= entries.back().contents->size();
+        index.erase(entries.back().key);
+        entries.pop_back();
+    }
+}
+
+// Returns the largest file that is cached. Bigger ones
+// would push out too much of everything else.
+size_t ContentCache::get_max_file(){
+    std::lock_guard lock(mut);
+    return capacity / 16;
+}
+
+// Returns the cached contents of the file at path if they
+// were read from the file that info describes, or nullptr
+ContentCache::Contents ContentCache::find(const std::string& path, const struct stat& info){
+    std::lock_guard lock(mut);
+    auto found = index.find(PathLocks::key(path));
+    if( found == index.end() ){
+        return nullptr;
+    }
+    std::list<Entry>::iterator entry = found->second;
+    if( !same_file(entry->info, info) ){
+        // Changed behind the server's back
+        used -= entry->contents->size();
+        entries.erase(entry);
+        index.erase(found);
+        return nullptr;
+    }
+    entries.splice(entries.begin(), entries, entry);
+    return entry->contents;
+}
+
+// Caches contents read from the file at path that info
+// describes, unless it is larger than get_max_file()
+void ContentCache::insert(const std::string& path, const struct stat& info, Contents contents){
+    std::lock_guard lock(mut);
+    if( capacity == 0 || contents->size() > capacity / 16 ){
+        return;
+    }
+    std::string key = PathLocks::key(path);
+    auto found = index.find(key);
+    if( found != index.end() ){
+        used -= found->second->contents->size();
+        entries.erase(found->second);
+    }
+    entries.push_front({ key, contents, info });
+    index[key] = entries.begin();
+    used += contents->size();
+    evict(capacity);
+}
+
+// Drops the entry for path, if any
+void ContentCache::invalidate(const std::string& path){
+    std::lock_guard lock(mut);
+    auto found = index.find(PathLocks::key(path));
+    if( found != index.end() ){
+        used -= found->second->contents->size();
+        entries.erase(found->second);
+        index.erase(found);
+    }
+}
+
+// Sets the size limit in bytes, evicting entries to fit.
+// 0 turns the cache off.
+void ContentCache::set_capacity(size_t bytes){
+    std::lock_guard lock(mut);
+    capacity = bytes;
+    evict(capacity);
+}
+
+// Constructor: Caches up to capacity bytes of contents
+ContentCache::ContentCache(size_t capacity)
+    : capacity(capacity)
+    , used(0)
+{
+}
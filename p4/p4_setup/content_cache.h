@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <mutex>
+#include <memory>
+#include <unordered_map>
+#include <sys/stat.h>
+
+///////////////////////////////////////////////////////////
+// Keeps the contents of recently loaded files in memory,
+// evicting the least recently used once they pass a size
+// limit. Contents are shared, immutable buffers: a LOAD
+// holds on to the one it was given while it is sent, so
+// neither a copy nor an eviction gets in its way.
+//
+// An entry is only used while the file still has the
+// device, inode, size and times it had when it was read,
+// which catches changes made outside the server. The
+// server's own STORE and DELETE drop their entries
+// directly.
+///////////////////////////////////////////////////////////
+class ContentCache {
+
+    public:
+
+    typedef std::shared_ptr<const std::string> Contents;
+
+    private:
+
+    struct Entry {
+        std::string key;
+        Contents    contents;
+        struct stat info;
+    };
+
+    std::mutex  mut;
+    size_t      capacity;
+    size_t      used;
+
+    // Most recently used first
+    std::list<Entry>                                          entries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+
+    // Drops least recently used entries until used is at
+    // most limit
+    void evict(size_t limit);
+
+    public:
+
+    // Returns the largest file that is cached. Bigger ones
+    // would push out too much of everything else.
+    size_t get_max_file();
+
+    // Returns the cached contents of the file at path if
+    // they were read from the file that info describes, or
+    // nullptr
+    Contents find(const std::string& path, const struct stat& info);
+
+    // Caches contents read from the file at path that info
+    // describes, unless it is larger than get_max_file()
+    void insert(const std::string& path, const struct stat& info, Contents contents);
+
+    // Drops the entry for path, if any
+    void invalidate(const std::string& path);
+
+    // Sets the size limit in bytes, evicting entries to fit.
+    // 0 turns the cache off.
+    void set_capacity(size_t bytes);
+
+    // Constructor: Caches up to capacity bytes of contents
+    ContentCache(size_t capacity);
+
+};
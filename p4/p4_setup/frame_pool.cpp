@@ -0,0 +1,62 @@
+#include "frame_pool.h"
+#include <bit>
+#include <algorithm>
+
+// Returns the smallest class whose buffers hold size bytes
+size_t FramePool::class_for(size_t size){
+    if( size < MIN_CLASS_SIZE ){
+        size = MIN_CLASS_SIZE;
+    }
+    return std::bit_width(size - 1) - std::bit_width(MIN_CLASS_SIZE - 1);
+}
+
+// Returns a buffer of size bytes, reusing a free one if
+// there is one that fits
+std::string FramePool::acquire(size_t size){
+    std::string buffer;
+    if( size <= MAX_CLASS_SIZE ){
+        size_t index = class_for(size);
+        {
+            std::lock_guard lock(mut);
+            if( !classes[index].empty() ){
+                buffer = std::move(classes[index].back());
+                classes[index].pop_back();
+                retained -= buffer.capacity();
+            }
+        }
+        if( buffer.capacity() == 0 ){
+            // Sized to the whole class, so it can be reused for
+            // any frame in it
+            buffer.reserve(MIN_CLASS_SIZE << index);
+        }
+    }
+    buffer.resize(size);
+    return buffer;
+}
+
+// Takes back a buffer for reuse, unless it is too big or
+// the pool already holds enough
+void FramePool::release(std::string buffer){
+    size_t capacity = buffer.capacity();
+    if( capacity < MIN_CLASS_SIZE || capacity > MAX_CLASS_SIZE * 2 ){
+        return;
+    }
+    // The largest class it covers
+    size_t index = std::min(class_for(capacity + 1) - 1, classes.size() - 1);
+    buffer.clear();
+    std::lock_guard lock(mut);
+    if( retained + capacity > max_retained ){
+        return;
+    }
+    retained += capacity;
+    classes[index].push_back(std::move(buffer));
+}
+
+// Constructor: Keeps up to max_retained bytes of free
+// buffers
+FramePool::FramePool(size_t max_retained)
+    : classes(class_for(MAX_CLASS_SIZE) + 1)
+    , retained(0)
+    , max_retained(max_retained)
+{
+}
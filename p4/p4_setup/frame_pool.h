@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////
+// Recycles the buffers that request frames are read into.
+// Buffers are kept in size classes, one per power of two
+// from MIN_CLASS_SIZE to MAX_CLASS_SIZE bytes: a buffer is
+// filed under the largest class its capacity covers, and
+// handed out for any frame no bigger than that class. So
+// once a server is warm, reading a request allocates
+// nothing.
+//
+// The pool holds at most max_retained bytes; past that, and
+// for frames too big for any class, buffers are simply
+// freed. Buffers are released by whichever worker finished
+// with a request, so the pool is locked.
+///////////////////////////////////////////////////////////
+class FramePool {
+
+    static const size_t MIN_CLASS_SIZE = 256;
+    static const size_t MAX_CLASS_SIZE = 1 << 20;
+
+    std::mutex                            mut;
+    std::vector<std::vector<std::string>> classes;   // free buffers, by size class
+    size_t                                retained;
+    size_t                                max_retained;
+
+    // Returns the smallest class whose buffers hold size bytes
+    static size_t class_for(size_t size);
+
+    public:
+
+    // Returns a buffer of size bytes, reusing a free one if
+    // there is one that fits
+    std::string acquire(size_t size);
+
+    // Takes back a buffer for reuse, unless it is too big or
+    // the pool already holds enough
+    void release(std::string buffer);
+
+    // Constructor: Keeps up to max_retained bytes of free
+    // buffers
+    FramePool(size_t max_retained);
+
+};
@@ -0,0 +1,96 @@
+#include "group_commit.h"
+#include <thread>
+#include <map>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Syncs each group as it fills. Never returns.
+void GroupCommit::run(){
+    std::unique_lock lock(mut);
+    while( true ){
+        arrived.wait(lock, [this]{ return !waiting->entries.empty(); });
+
+        // A lone caller is synced at once. Once callers are
+        // queueing up, more are likely on the way, so they are
+        // given a moment to join.
+        if( window.count() > 0 && waiting->entries.size() > 1 ){
+            lock.unlock();
+            std::this_thread::sleep_for(window);
+            lock.lock();
+        }
+        std::shared_ptr<Group> group = waiting;
+        waiting = std::make_shared<Group>();
+
+        lock.unlock();
+        flush(*group);
+        lock.lock();
+        group->done = true;
+        finished.notify_all();
+    }
+}
+
+// Syncs every file in a group, recording which made it
+void GroupCommit::flush(Group& group){
+    if( group.entries.size() == 1 ){
+        group.entries[0].synced = (fsync(group.entries[0].fd) == 0);
+        return;
+    }
+
+    // One syncfs covers every file on its filesystem
+    std::map<dev_t, std::vector<Entry*>> devices;
+    for(Entry& entry : group.entries){
+        struct stat info;
+        if( fstat(entry.fd, &info) == 0 ){
+            devices[info.st_dev].push_back(&entry);
+        } else {
+            entry.synced = false;
+        }
+    }
+    for(auto& [device, entries] : devices){
+        bool synced = (syncfs(entries[0]->fd) == 0);
+        // Before Linux 5.8, syncfs doesn't report writeback
+        // errors, so each file is also fsynced. With its data
+        // already written back, that is cheap, and it reports
+        // the file's own errors.
+        for(Entry *entry : entries){
+            entry->synced = (fsync(entry->fd) == 0) && synced;
+        }
+    }
+}
+
+// Returns true once fd's contents (for a directory, its
+// entries) are on disk, and false if syncing it failed.
+// Blocks until its group has been synced.
+bool GroupCommit::sync(int fd){
+    std::unique_lock lock(mut);
+    if( !started ){
+        // Nothing to group with
+        lock.unlock();
+        return fsync(fd) == 0;
+    }
+    std::shared_ptr<Group> group = waiting;
+    size_t index = group->entries.size();
+    group->entries.push_back({ fd, false });
+    arrived.notify_one();
+    finished.wait(lock, [&group]{ return group->done; });
+    return group->entries[index].synced;
+}
+
+// Starts the flusher thread, which waits window_us
+// microseconds for more callers before syncing a group of
+// several
+void GroupCommit::start(int window_us){
+    std::lock_guard lock(mut);
+    window  = std::chrono::microseconds(window_us);
+    started = true;
+    std::thread(&GroupCommit::run, this).detach();
+}
+
+// Constructor: Makes an idle group commit, started by
+// start()
+GroupCommit::GroupCommit()
+    : window(0)
+    , waiting(std::make_shared<Group>())
+    , started(false)
+{
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+///////////////////////////////////////////////////////////
+// Makes files durable in groups. A caller hands over an
+// open file and waits; a flusher thread syncs the whole
+// group at once and wakes them all. Callers that arrive
+// while a group is being synced form the next one. A lone
+// caller is synced at once; when several are waiting, a
+// short window passes first so more can join.
+//
+// A group of one file is synced with fsync. A bigger group
+// is written back with one syncfs per filesystem it
+// touches, which costs about as much as a single fsync
+// however many files are waiting, and then each file is
+// fsynced, which finds little left to do but reports
+// errors that syncfs misses before Linux 5.8.
+///////////////////////////////////////////////////////////
+class GroupCommit {
+
+    struct Entry {
+        int  fd;
+        bool synced;
+    };
+
+    struct Group {
+        std::vector<Entry> entries;
+        bool               done = false;
+    };
+
+    std::mutex                mut;
+    std::condition_variable   arrived;   // the flusher waits on this
+    std::condition_variable   finished;  // callers wait on this
+    std::chrono::microseconds window;
+    std::shared_ptr<Group>    waiting;   // the group callers are joining
+    bool                      started;
+
+    // Syncs each group as it fills. Never returns.
+    void run();
+
+    // Syncs every file in a group, recording which made it
+    static void flush(Group& group);
+
+    public:
+
+    // Returns true once fd's contents (for a directory, its
+    // entries) are on disk, and false if syncing it failed.
+    // Blocks until its group has been synced.
+    bool sync(int fd);
+
+    // Starts the flusher thread, which waits window_us
+    // microseconds for more callers before syncing a group
+    // of several
+    void start(int window_us);
+
+    // Constructor: Makes an idle group commit, started by
+    // start()
+    GroupCommit();
+
+};
@@ -0,0 +1,161 @@
+#include "metadata_cache.h"
+#include "path_locks.h"
+#include <stdexcept>
+#include <thread>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+// Entries kept before the table is cleared out, so checks
+// over huge numbers of paths can't grow it without limit
+static const size_t MAX_ENTRIES = 1 << 20;
+
+// Returns the directory that holds the file with the input
+// key, as inotify should be given it
+static std::string directory_of(const std::string& key){
+    size_t slash = key.rfind('/');
+    if( slash == std::string::npos ){
+        return ".";
+    }
+    return (slash == 0) ? "/" : key.substr(0, slash);
+}
+
+// Starts watching the directory that holds the file with
+// the input key, if it isn't yet. Must be called holding
+// mut.
+void MetadataCache::watch_directory(const std::string& key){
+    std::string directory = directory_of(key);
+    if( directories.count(directory) ){
+        return;
+    }
+    int wd = inotify_add_watch(inotify_fd, directory.c_str(),
+                               IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                               IN_DELETE_SELF | IN_MOVE_SELF);
+    if( wd < 0 ){
+        // Missing directories and running out of watches just
+        // leave the time to live in charge
+        return;
+    }
+    watched[wd] = directory;
+    directories.insert(directory);
+}
+
+// Drops entries as inotify reports changes. Never returns.
+void MetadataCache::read_events(){
+    alignas(inotify_event) char buffer[64 * 1024];
+    while( true ){
+        ssize_t length = read(inotify_fd, buffer, sizeof(buffer));
+        if( length <= 0 ){
+            if( length < 0 && errno == EINTR ){
+                continue;
+            }
+            return;
+        }
+        std::lock_guard lock(mut);
+        epoch++;
+        for(char *next = buffer; next < buffer + length; ){
+            inotify_event *event = (inotify_event *) next;
+            next += sizeof(inotify_event) + event->len;
+
+            auto found = watched.find(event->wd);
+            if( event->mask & IN_IGNORED ){
+                if( found != watched.end() ){
+                    directories.erase(found->second);
+                    watched.erase(found);
+                }
+                continue;
+            }
+            // Lost events, a watched directory going away, or
+            // a directory moving under watched paths can touch
+            // any entry
+            if( (event->mask & (IN_Q_OVERFLOW | IN_DELETE_SELF | IN_MOVE_SELF | IN_ISDIR)) ||
+                found == watched.end() ){
+                entries.clear();
+                continue;
+            }
+            if( event->len > 0 ){
+                std::string directory = found->second;
+                std::string name      = event->name;
+                if( directory != "." ){
+                    name = ((directory == "/") ? directory : directory + "/") + name;
+                }
+                entries.erase(PathLocks::key(name));
+            }
+        }
+    }
+}
+
+// Returns STATUS_OK and fills in the metadata of the file
+// at path if it exists, and returns STATUS_NOT_FOUND if
+// not. Answers from the cache while the entry is fresh.
+uint8_t MetadataCache::lookup(const std::string& path, Metadata& metadata){
+    std::string key = PathLocks::key(path);
+    auto now = std::chrono::steady_clock::now();
+    uint64_t seen_epoch;
+    {
+        std::lock_guard lock(mut);
+        auto found = entries.find(key);
+        if( found != entries.end() && found->second.expires > now ){
+            metadata = found->second.metadata;
+            return found->second.status;
+        }
+        seen_epoch = epoch;
+        // Watched before the stat, so a change right after it
+        // is still heard about
+        if( inotify_fd >= 0 && ttl.count() > 0 ){
+            watch_directory(key);
+        }
+    }
+
+    struct stat info;
+    uint8_t status = STATUS_NOT_FOUND;
+    metadata = Metadata();
+    if( stat(path.c_str(), &info) == 0 ){
+        status            = STATUS_OK;
+        metadata.size     = info.st_size;
+        metadata.mtime_ns = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    }
+
+    std::lock_guard lock(mut);
+    if( ttl.count() > 0 && epoch == seen_epoch ){
+        if( entries.size() >= MAX_ENTRIES ){
+            entries.clear();
+        }
+        entries[key] = { status, metadata, now + ttl };
+    }
+    return status;
+}
+
+// Drops the entry for path, if any
+void MetadataCache::invalidate(const std::string& path){
+    std::lock_guard lock(mut);
+    epoch++;
+    entries.erase(PathLocks::key(path));
+}
+
+// Sets how long entries are trusted, in milliseconds.
+// 0 turns the cache off.
+void MetadataCache::set_ttl(int ttl_ms){
+    std::lock_guard lock(mut);
+    ttl = std::chrono::milliseconds(ttl_ms);
+    entries.clear();
+}
+
+// Starts watching checked directories with inotify. Throws
+// a runtime exception if it is not available.
+void MetadataCache::watch(){
+    inotify_fd = inotify_init1(IN_CLOEXEC);
+    if( inotify_fd < 0 ){
+        throw std::runtime_error("Could not set up inotify.");
+    }
+    std::thread(&MetadataCache::read_events, this).detach();
+}
+
+// Constructor: Trusts entries for ttl_ms milliseconds
+MetadataCache::MetadataCache(int ttl_ms)
+    : ttl(ttl_ms)
+    , epoch(0)
+    , inotify_fd(-1)
+{
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+#include "protocol.h"
+
+///////////////////////////////////////////////////////////
+// Remembers what CHECK found for recently checked paths,
+// including paths that don't exist, so repeated checks
+// don't each go to the filesystem. Entries expire after a
+// short time to live, which bounds how long a change made
+// outside the server goes unnoticed. The server's own
+// STORE and DELETE drop their entries directly.
+//
+// Optionally, the directories of checked paths are also
+// watched with inotify, and any change in them drops the
+// affected entries as soon as it happens.
+///////////////////////////////////////////////////////////
+class MetadataCache {
+
+    struct Entry {
+        uint8_t                               status;
+        Metadata                              metadata;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    std::mutex                             mut;
+    std::unordered_map<std::string, Entry> entries;
+    std::chrono::milliseconds              ttl;
+
+    // Counts invalidations, so a lookup that races one
+    // doesn't cache what it found
+    uint64_t epoch;
+
+    // inotify state; inotify_fd is negative when not
+    // watching
+    int                                  inotify_fd;
+    std::unordered_map<int, std::string> watched;      // by watch descriptor
+    std::unordered_set<std::string>      directories;  // that are watched
+
+    // Starts watching the directory that holds the file
+    // with the input key, if it isn't yet. Must be called
+    // holding mut.
+    void watch_directory(const std::string& key);
+
+    // Drops entries as inotify reports changes. Never
+    // returns.
+    void read_events();
+
+    public:
+
+    // Returns STATUS_OK and fills in the metadata of the
+    // file at path if it exists, and returns
+    // STATUS_NOT_FOUND if not. Answers from the cache while
+    // the entry is fresh.
+    uint8_t lookup(const std::string& path, Metadata& metadata);
+
+    // Drops the entry for path, if any
+    void invalidate(const std::string& path);
+
+    // Sets how long entries are trusted, in milliseconds.
+    // 0 turns the cache off.
+    void set_ttl(int ttl_ms);
+
+    // Starts watching checked directories with inotify.
+    // Throws a runtime exception if it is not available.
+    void watch();
+
+    // Constructor: Trusts entries for ttl_ms milliseconds
+    MetadataCache(int ttl_ms);
+
+};
@@ -12,16 +12,69 @@
 #include <sys/socket.h>
 // TCP/IP protocol functionaltiy
 #include <arpa/inet.h>
+#include <netinet/tcp.h>
 #include <signal.h>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <fstream>
 #include <cstring>
 #include <climits>
 #include <vector>
-
-int BUFFER_SIZE = INT_MAX;
-std::string FOUND = "FOUND";
-std::string NOT_FOUND = "NOT_FOUND";
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <ctime>
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <memory>
+#include "worker_pool.h"
+#include "path_locks.h"
+#include "reactor.h"
+#include "protocol.h"
+#include "content_cache.h"
+#include "metadata_cache.h"
+#include "compression.h"
+#include "group_commit.h"
+#include "stats.h"
+
+//each client request gets its own id, which its response carries back. downloads split across connections take
+//ids from several threads
+std::atomic<uint32_t> next_request_id = 1;
+
+//paths per BATCH request, and requests a client keeps in flight at once when it has many to make. the server
+//stops reading a connection with 64 in flight, so this stays below that
+const size_t BATCH_PATHS = 1024;
+const size_t MAX_PIPELINED = 32;
+
+//requests on the same file take turns through these; requests on different files don't wait on each other
+PathLocks path_locks;
+
+//recently loaded files, so hot ones are served from memory. sized by the server's --cache option
+ContentCache content_cache(64 << 20);
+
+//what CHECK found for recently checked paths, existing or not. entries live for the server's --check-ttl option
+MetadataCache metadata_cache(1000);
+
+//LOAD replies at least this big are compressed when the client's HELLO settled on a codec, and 0 turns
+//compression off. set by the server's --compress-min option
+size_t compress_min = COMPRESS_MIN_SIZE;
+
+//the biggest range of a file that isn't cached which is read into memory to be compressed. past it, the range is
+//sent as it is with sendfile
+const size_t MAX_COMPRESSED_LOAD = 8 << 20;
+
+//with the server's --durable option, a STORE is only acknowledged once its contents and its rename are on disk.
+//the syncs of concurrent STOREs are grouped, waiting up to --sync-window microseconds for each other
+bool durable = false;
+GroupCommit group_commit;
+
+//what the server has done, answered to STATS requests and written out every --stats-interval seconds to the
+//server's --stats-file
+Stats stats;
 
 typedef void (*sighandler_t)(int);
 sighandler_t signal(int signum, sighandler_t handler);
@@ -31,11 +84,63 @@ void sigint_handler(int signum) {
     exit(1);
 }
 
+// What a client was asked to do, besides its mode
+struct ClientOptions {
+    std::vector<std::string> paths;
+    std::string directory;      // --dir: where many loaded files are saved
+    std::string output;         // --output: where one loaded file is saved
+    bool resume = false;        // --resume: carry on with an interrupted --output download
+    int parallel = 1;           // --parallel: connections an --output download is split across
+    Range range;                // --offset and --length: the part of the file to load
+};
+
+// A stretch of a download, and how far into it the bytes
+// have been saved
+struct DownloadPart {
+    uint64_t next;
+    uint64_t end;
+};
+
+// Where a download stands, kept in a file beside its
+// output so it can be resumed
+struct DownloadProgress {
+    std::mutex mut;
+    std::string path;
+    Metadata metadata;
+    Range range;
+    std::vector<DownloadPart> parts;
+};
+
+// What a benchmark runs, set by the options of 'p4 bench'
+struct BenchOptions {
+    int connections = 8;        // --connections: clients run at once, each on its own connection
+    int duration_s = 10;        // --duration: seconds to run for
+    double rate = 1000;         // --rate: requests per second across all connections, or 0 for as many as they can
+    size_t file_size = 4096;    // --size: bytes per stored file
+    int files = 100;            // --files: files the requests pick from
+    std::string prefix = "p4bench_";                      // --prefix: what the files' names start with
+    std::vector<std::pair<uint8_t, int>> mix = { { OP_CHECK, 40 }, { OP_LOAD, 40 }, { OP_STORE, 15 },
+                                                 { OP_DELETE, 5 } };  // --mix: weight of each request
+};
+
+// What a benchmark measured for one kind of request. Several
+// connections record into it at once
+struct BenchResults {
+    Histogram latency_us;
+    std::atomic<uint64_t> not_found = 0;
+    std::atomic<uint64_t> errors = 0;
+    std::atomic<uint64_t> bytes = 0;
+};
+
 // Clients need an ip address and a port number to connect to
-void client(in_addr_t ip,in_port_t port, std::string path, std::string mode);
+void client(in_addr_t ip,in_port_t port, std::string mode, const ClientOptions& options);
 // Servers pick an arbitrary port number and reports its port
-// number to the user
-void server();
+// number to the user. Connections are served by 'loops' event
+// loop threads sharing the port, which hand requests to a
+// pool of 'threads' workers with up to 'queue_size' requests
+// waiting for a free worker. Request frames over 'max_frame'
+// bytes are refused.
+void server(int loops, int threads, size_t queue_size, uint64_t max_frame);
 
 // Functions for parsing ip addresses and port numbers from
 // c strings
@@ -47,41 +152,212 @@ in_port_t parse_port(char* port_str);
 int connect_to(in_addr_t ip, in_port_t port);
 // Returns a socket bound to an arbitrary port
 int arbitrary_socket();
+// Returns a socket bound to the given port (or an arbitrary
+// one for port 0) that other sockets can bind to as well
+int reuse_port_socket(in_port_t port);
 // Returns the port of the socket referenced by the input file descriptor
 in_port_t get_port(int socket_fd);
 
-//desc: sends message to a socket. it is sent in chunks in order to handle larger inputs.
-//pre : -socket fd and the message itself is passed in
-//      -the send syscall is warmed up via sending the size of the message
-//post: -the socket fd has updated values containing the message
-void send_message(int connection_fd, std::string& message);
-
-//desc: receives message from a socket. it processes the message in chunks in order to correspond with the send function.
-//pre : -socket fd and the message itself is passed in
-//      -the send_message function should have a "chunked" implementation.
-//post: -returns the message in the socket fd
-std::string recv_message(int connection_fd);
+//desc: sends a message to a socket. it is sent in chunks in order to handle larger inputs.
+//pre : -socket fd, the message's header and its path and payload are passed in
+//post: -the header's lengths are filled in from the path and payload, and the message is sent
+void send_message(int connection_fd, Header header, const std::string& path, const std::string& payload);
+
+//desc: receives exactly length bytes from a socket
+//pre : -socket fd and somewhere to put the bytes are passed in
+//post: -data holds the bytes, or a runtime exception is thrown if the connection ends first
+void recv_exact(int connection_fd, char* data, size_t length);
+
+//desc: receives the header of a message from a socket, leaving its path and payload to be read
+//pre : -socket fd is passed in
+//post: -returns the header, or throws a runtime exception if it is not of this protocol version or its path is
+//       over MAX_FRAME_SIZE
+Header recv_header(int connection_fd);
+
+//desc: guards what is read into memory whole against a bogus length from the peer
+//pre : -length is the size of a path or payload about to be read whole
+//post: -throws a runtime exception if it is over MAX_FRAME_SIZE
+void check_frame_size(uint64_t length);
+
+//desc: receives the header of a response and the whole payload that follows it
+//pre : -socket fd is passed in, and a response is expected
+//post: -returns the payload, and the header through the second argument. throws a runtime exception if the
+//       payload is over MAX_FRAME_SIZE
+std::string recv_response(int connection_fd, Header& header);
+
+//desc: opens a connection by trading HELLOs with the server, offering it every codec this build has
+//pre : -socket fd is a fresh connection to the server
+//post: -returns the codec the server picked for the connection, or CODEC_NONE
+//      -throws a runtime exception if the server does not speak this protocol version
+uint8_t hello(int socket_no);
+
+//desc: runs one request received by the server and builds the reply
+//pre : -request is a complete request as sent by the client
+//      -runs on a worker thread, holding the request's path lock until it returns
+//post: -returns the reply, starting with its response header, which may end with the contents of a file
+Reply handle_request(const Request& request);
+
+//desc: starts a STORE, whose contents follow the request as DATA messages, the last flagged FIN
+//pre : -request is the STORE request
+//      -runs on a worker thread, before any of the contents are read
+//post: -returns a reply that has the event loop write the contents to a temporary file beside the path.
+//       once they are all in, the temporary file is renamed over the path and OK is sent; if the upload
+//       is cut short or fails, it is removed and the file is left as it was. in durable mode the contents
+//       are synced before the rename, and the directory after it, before OK is sent
+Reply begin_store(const Request& request);
+
+//desc: asks the server for its counters and prints them
+//pre : -socket_no is connected to the server
+//post: -return the corresponding exit status
+int print_stats(int socket_no);
+
+//desc: makes the entries of the directory holding path durable, through the group commit
+//pre : -path is a file whose directory entry just changed
+//post: -returns false if the directory could not be synced
+bool sync_directory(const std::string& path);
+
+//desc: runs a LOAD of a range of a file
+//pre : -header is the request's, path is the file to load, and codec is the one its connection settled on
+//      -runs on a worker thread, and takes the path's lock itself
+//post: -returns the reply: the file's metadata and the range, cut to the end of the file, or STATUS_NOT_FOUND.
+//       the range is compressed if that makes it smaller
+Reply load_path(const Header& header, const std::string& path, Range range, uint8_t codec);
+
+//desc: reads length bytes of an open file from offset
+//pre : -fd is open for reading, and buffer has room for length bytes
+//post: -returns false if the file ends or fails first
+bool read_fully(int fd, char* buffer, size_t length, off_t offset);
+
+//desc: runs a CHECK on one path, alone or as part of a BATCH
+//pre : -path is the file to look for
+//      -runs on a worker thread, and takes the path's lock itself
+//post: -returns STATUS_OK and fills in metadata if the file exists, and STATUS_NOT_FOUND if not
+uint8_t check_path(const std::string& path, Metadata& metadata);
+
+//desc: runs a DELETE on one path, alone or as part of a BATCH
+//pre : -path is the file to delete
+//      -runs on a worker thread, and takes the path's lock itself
+//post: -returns STATUS_OK once the file is deleted, STATUS_NOT_FOUND if it did not exist, and STATUS_FAILED
+//       if it could not be deleted
+uint8_t delete_path(const std::string& path);
 
 //desc: checks if a file path is valid
 //pre : -filepath and socket_no is passed in
 //post: -return the corresponding exit status
 int check(std::string path, int socket_no);
 
-//desc: prints a file's contents if the file exists
-//pre : -filepath and socket_no is passed in
+//desc: prints a file's contents, or a range of them, if the file exists
+//pre : -filepath, range and socket_no is passed in
 //post: -return the corresponding exit status
-int load(std::string path, int socket_no);
+int load(std::string path, Range range, int socket_no);
+
+//desc: receives the start of a LOAD's response, up to the contents
+//pre : -socket fd is passed in, and a LOAD response is expected
+//post: -returns the response's status. for STATUS_OK, the header and the file's metadata are filled in, and
+//       length is set to the bytes of contents that follow on the socket
+uint8_t recv_load_response(int socket_no, Header& response, Metadata& metadata, uint64_t& length);
+
+//desc: receives the contents of a LOAD response, expanding them if they came compressed
+//pre : -the response and its metadata have been received, and length bytes of the payload follow
+//      -expected is the length of the range asked for, cut to the file
+//post: -the contents are handed to write a bounded chunk at a time, and the payload is read off the socket
+//       either way. returns false if write does, or if the contents don't come to expected bytes
+bool recv_contents(int socket_no, const Header& response, uint64_t length, uint64_t expected,
+                   const std::function<bool(const char*, size_t)>& write);
+
+//desc: saves a file, or a range of it, to options.output, split across options.parallel connections. its
+//      progress is kept in a file beside the output until it is done, so with options.resume an interrupted
+//      download carries on where each connection stopped, as long as the file hasn't changed since
+//pre : -the ip and port of the server, the path, options, and a connected socket_no are passed in
+//post: -returns 0 once the file is saved, and 1 if not
+int download(in_addr_t ip, in_port_t port, std::string path, const ClientOptions& options, int socket_no);
+
+//desc: fetches one part of a download into the output file, recording how far it gets
+//pre : -socket_no is a connection of its own, fd is the open output, and index is the part to fetch
+//post: -the part is saved, or a runtime exception is thrown with the progress up to it recorded
+void fetch_part(int socket_no, std::string path, int fd, DownloadProgress& progress, size_t index);
+
+//desc: writes a download's progress beside its output
+//pre : -the caller holds progress.mut
+//post: -the progress file is replaced in one step, so it is never seen half-written
+void save_progress(DownloadProgress& progress);
+
+//desc: reads back the progress of an earlier download
+//pre : -progress has the path, metadata and range of the download being resumed
+//post: -returns true and fills in the parts if the file has progress for this same file and range
+bool read_progress(DownloadProgress& progress);
+
+//desc: sends part of a STORE's contents as one DATA message, compressed if the connection has a codec and that
+//      makes it smaller
+//pre : -request_id is the STORE's, and codec is the one the connection's HELLO settled on
+//post: -the message is sent, flagged FIN if fin is true
+void send_data(int socket_no, uint32_t request_id, uint8_t codec, const char* data, size_t length, bool fin);
+
+//desc: runs the benchmark: stores the files, then has options.connections clients send the mix of requests
+//      for options.duration_s seconds, and deletes the files again
+//pre : -the ip and port of a running server and the options are passed in
+//post: -prints throughput and latency percentiles for each kind of request. returns 0, or 1 if it couldn't run
+int bench(in_addr_t ip, in_port_t port, const BenchOptions& options);
+
+//desc: runs one benchmark client on its own connection until deadline
+//pre : -index is the client's, from 0, and contents is what STOREs send
+//post: -each request's latency and result is recorded in results, by the kind of request
+void bench_client(in_addr_t ip, in_port_t port, const BenchOptions& options, int index, const std::string& contents,
+                  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point deadline,
+                  std::unordered_map<uint8_t, std::unique_ptr<BenchResults>>& results);
+
+//desc: sends one benchmark request and waits for its response
+//pre : -opcode is OP_CHECK, OP_LOAD, OP_STORE or OP_DELETE, and codec is the one the connection's HELLO settled
+//       on
+//post: -returns the response's status, or STATUS_FAILED for a LOAD whose contents don't come back whole, and
+//       adds the bytes of the file loaded or stored to bytes
+uint8_t bench_request(int socket_no, uint8_t opcode, const std::string& path, const std::string& contents,
+                      uint8_t codec, uint64_t& bytes);
+
+//desc: collects the options of 'p4 bench'
+//pre : -the arguments from index first on are options
+//post: -the options are filled in. returns false if any can't be read
+bool parse_bench_options(int argc, char* argv[], int first, BenchOptions& options);
 
 //desc: stores input from stdin into a file. If file does not exist, create.
-//pre : -filepath and socket_no is passed in
+//pre : -filepath, the codec the connection's HELLO settled on, and socket_no is passed in
 //post: -return the corresponding exit status
-int store(std::string path, int socket_no);
+int store(std::string path, uint8_t codec, int socket_no);
 
 //desc: deletes a file
 //pre : -filepath and socket_no is passed in
 //post: -return the corresponding exit status
 int delete_fx(std::string path, int socket_no);
 
+//desc: runs a CHECK or DELETE over many paths, sent in BATCH requests of BATCH_PATHS paths with several in
+//      flight at once
+//pre : -opcode is OP_CHECK or OP_DELETE, and the paths and socket_no are passed in
+//post: -prints each path's result in order, and returns 0 if every one succeeded and 1 if not
+int batch(uint8_t opcode, const std::vector<std::string>& paths, int socket_no);
+
+//desc: loads many files, with several LOAD requests in flight at once, saving each one under directory at
+//      its own path
+//pre : -paths, directory and socket_no are passed in
+//post: -prints each path's result as it comes in, and returns 0 if every file was saved and 1 if not
+int load_all(const std::vector<std::string>& paths, std::string directory, int socket_no);
+
+//desc: describes a file's metadata for the user
+//pre : -metadata is what a CHECK reported
+//post: -returns its size and local modification time, e.g. "12 bytes, modified 2024-03-01 12:00:00"
+std::string describe_metadata(const Metadata& metadata);
+
+//desc: collects the paths and options given to a client mode
+//pre : -the arguments from index first on are paths, '--manifest <file>' (one path per line), or the load
+//       options '--dir <directory>', '--output <file>', '--resume', '--parallel <count>', '--offset <bytes>'
+//       and '--length <bytes>'
+//post: -the options are filled in. returns false if the arguments or manifest can't be read
+bool parse_client_options(int argc, char* argv[], int first, ClientOptions& options);
+
+//desc: tells whether any of the options that only LOAD takes were given
+//pre : -options were parsed
+//post: -returns true if so
+bool has_load_options(const ClientOptions& options);
+
 
 //desc: runs either on client or server mode. the objective is for the client to be able to manipulate files in the server's directory.
 //pre : -in order for implementation to be fully shown off, you must have a client to run the program and a server to run the program.
@@ -97,43 +373,128 @@ int main(int argc, char *argv[]) {
     // Switch arg handling and execution based upon the mode
     std::string mode = argv[1];
     if (mode == "server"){
-        // Servers need no arguments, and simply report the port and
+        // Servers only take options, and simply report the port and
         // ip address they end up having
-        if(argc != 2){
-            std::cout << "Usage: p4 server" << std::endl;
-            exit(1);
+        int loops = 0;
+        int threads = 0;
+        size_t queue_size = 1024;
+        size_t cache_mib = 64;
+        int check_ttl = 1000;
+        int compress_bytes = COMPRESS_MIN_SIZE;
+        int sync_window = 2000;
+        std::string stats_file;
+        int stats_interval = 10;
+        uint64_t max_frame = MAX_FRAME_SIZE;
+        bool watch = false;
+        for (int i = 2; i < argc; i += 2) {
+            std::string option = argv[i];
+            bool has_value = (i + 1 < argc);
+            if (option == "--watch" || option == "--durable") {
+                //the options without a value
+                if (option == "--watch") {
+                    watch = true;
+                } else {
+                    durable = true;
+                }
+                i--;
+            } else if (has_value && option == "--loops") {
+                loops = atoi(argv[i + 1]);
+            } else if (has_value && option == "--threads") {
+                threads = atoi(argv[i + 1]);
+            } else if (has_value && option == "--queue" && atoi(argv[i + 1]) > 0) {
+                queue_size = atoi(argv[i + 1]);
+            } else if (has_value && option == "--cache" && atoi(argv[i + 1]) >= 0) {
+                cache_mib = atoi(argv[i + 1]);
+            } else if (has_value && option == "--check-ttl" && atoi(argv[i + 1]) >= 0) {
+                check_ttl = atoi(argv[i + 1]);
+            } else if (has_value && option == "--compress-min" && atoi(argv[i + 1]) >= 0) {
+                compress_bytes = atoi(argv[i + 1]);
+            } else if (has_value && option == "--sync-window" && atoi(argv[i + 1]) >= 0) {
+                sync_window = atoi(argv[i + 1]);
+            } else if (has_value && option == "--stats-file") {
+                stats_file = argv[i + 1];
+            } else if (has_value && option == "--stats-interval" && atoi(argv[i + 1]) > 0) {
+                stats_interval = atoi(argv[i + 1]);
+            } else if (has_value && option == "--max-frame" && strtoull(argv[i + 1], nullptr, 10) > 0) {
+                max_frame = strtoull(argv[i + 1], nullptr, 10);
+            } else {
+                std::cout << "Usage: p4 server [--loops <count>] [--threads <count>] [--queue <requests>]"
+                          << " [--cache <MiB>] [--check-ttl <ms>] [--watch] [--compress-min <bytes>]"
+                          << " [--durable] [--sync-window <us>] [--stats-file <file>] [--stats-interval <s>]"
+                          << " [--max-frame <bytes>]" << std::endl;
+                exit(1);
+            }
+        }
+        content_cache.set_capacity(cache_mib << 20);
+        metadata_cache.set_ttl(check_ttl);
+        compress_min = compress_bytes;
+        if (!stats_file.empty()) {
+            stats.dump_every(stats_file, stats_interval);
+        }
+        if (durable) {
+            group_commit.start(sync_window);
+        }
+        if (watch) {
+            metadata_cache.watch();
         }
-        server();
+        server(loops, threads, queue_size, max_frame);
     } else if (mode == "check") {
-        if(argc < 5) {
-            std::cout << "Usage: p4 check <ip> <port> <path>" << std::endl;
+        //check if the paths exist in the server
+        ClientOptions options;
+        if(argc < 5 || !parse_client_options(argc, argv, 4, options) || options.paths.empty() ||
+           has_load_options(options)) {
+            std::cout << "Usage: p4 check <ip> <port> <path> ... [--manifest <file>]" << std::endl;
             exit(1);
         }
-        //check if the path exists in the server
-        std::string path = argv[4];
-        client(parse_ip(argv[2]), parse_port(argv[3]), path, mode);
+        client(parse_ip(argv[2]), parse_port(argv[3]), mode, options);
         //exit with the status it returns
     } else if (mode == "load"){
-        if(argc < 5) {
-            std::cout << "Usage: p4 load <ip> <port> <path>" << std::endl;
+        //one file is printed or saved to a file, and many are saved under a directory
+        ClientOptions options;
+        bool parsed = (argc >= 5 && parse_client_options(argc, argv, 4, options) && !options.paths.empty());
+        bool many = (options.paths.size() > 1 || !options.directory.empty());
+        bool ranged = (options.range.offset != 0 || options.range.length != UINT64_MAX);
+        bool saved = (options.resume || options.parallel != 1);
+        if(!parsed || (many && (options.directory.empty() || !options.output.empty() || ranged || saved)) ||
+           (saved && options.output.empty())) {
+            std::cout << "Usage: p4 load <ip> <port> <path> [--offset <bytes>] [--length <bytes>]" << std::endl;
+            std::cout << "       p4 load <ip> <port> <path> [--offset <bytes>] [--length <bytes>] --output <file>"
+                      << " [--resume] [--parallel <count>]" << std::endl;
+            std::cout << "       p4 load <ip> <port> <path> ... [--manifest <file>] --dir <directory>" << std::endl;
             exit(1);
         }
-        std::string path = argv[4];
-        client(parse_ip(argv[2]), parse_port(argv[3]), path, mode);
+        client(parse_ip(argv[2]), parse_port(argv[3]), mode, options);
     } else if (mode == "store") {
-        if(argc < 5) {
+        if(argc != 5) {
             std::cout << "Usage: p4 store <ip> <port> <path>" << std::endl;
             exit(1);
         }
-        std::string path = argv[4];
-        client(parse_ip(argv[2]), parse_port(argv[3]), path, mode);
+        ClientOptions options;
+        options.paths.push_back(argv[4]);
+        client(parse_ip(argv[2]), parse_port(argv[3]), mode, options);
     } else if (mode == "delete") {
-        if(argc < 5) {
-            std::cout << "Usage: p4 delete <ip> <port> <path>" << std::endl;
+        ClientOptions options;
+        if(argc < 5 || !parse_client_options(argc, argv, 4, options) || options.paths.empty() ||
+           has_load_options(options)) {
+            std::cout << "Usage: p4 delete <ip> <port> <path> ... [--manifest <file>]" << std::endl;
             exit(1);
         }
-        std::string path = argv[4];
-        client(parse_ip(argv[2]), parse_port(argv[3]), path, mode);
+        client(parse_ip(argv[2]), parse_port(argv[3]), mode, options);
+    } else if (mode == "bench") {
+        BenchOptions options;
+        if(argc < 4 || !parse_bench_options(argc, argv, 4, options)) {
+            std::cout << "Usage: p4 bench <ip> <port> [--connections <count>] [--duration <s>]"
+                      << " [--rate <requests/s>] [--mix check=40,load=40,store=15,delete=5] [--size <bytes>]"
+                      << " [--files <count>] [--prefix <name>]" << std::endl;
+            exit(1);
+        }
+        exit(bench(parse_ip(argv[2]), parse_port(argv[3]), options));
+    } else if (mode == "stats") {
+        if(argc != 4) {
+            std::cout << "Usage: p4 stats <ip> <port>" << std::endl;
+            exit(1);
+        }
+        client(parse_ip(argv[2]), parse_port(argv[3]), mode, ClientOptions());
     } else {
         std::cout << "Mode '" << mode << "' not recognized" << std::endl;
     }
@@ -216,6 +577,11 @@ int connect_to(in_addr_t ip, in_port_t port) {
         close(socket_fd);
         throw std::runtime_error("Connection failed.");
     }
+    // Requests are small messages sent back to back on one
+    // connection, so each goes out at once rather than
+    // waiting on Nagle for the previous one to be ACKed
+    int on = 1;
+    setsockopt(socket_fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
     return socket_fd;
 }
 
@@ -249,6 +615,39 @@ int arbitrary_socket() {
     return socket_fd;
 }
 
+// desc : Returns a socket bound to the given port, or an
+//        arbitrary one for port 0, with SO_REUSEPORT set so
+//        that several sockets can listen on the same port and
+//        have the kernel balance connections between them
+// pre  : None
+// post : If an error is returned, a runtime exception is thrown
+int reuse_port_socket(in_port_t port) {
+    sockaddr_in socket_addr;
+    socket_addr.sin_family = AF_INET;
+    socket_addr.sin_addr.s_addr = INADDR_ANY;
+    socket_addr.sin_port = htons(port);
+
+    int socket_fd = make_tcp_ip_socket();
+
+    // The option must be set on every socket sharing the port,
+    // before binding
+    int on = 1;
+    if (setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0) {
+        close(socket_fd);
+        throw std::runtime_error("Could not share port.");
+    }
+    int status = bind(
+        socket_fd,
+        (struct sockaddr *) &socket_addr,
+        sizeof(sockaddr_in)
+    );
+    if(status < 0) {
+        close(socket_fd);
+        throw std::runtime_error("Binding failed.");
+    }
+    return socket_fd;
+}
+
 // desc : Returns the port that the provided file descriptor's
 //        socket is bound to
 // pre  : The provided socket file descriptor is valid
@@ -272,143 +671,332 @@ in_port_t get_port(int socket_fd) {
     return ntohs(socket_addr.sin_port);
 }
 
-void send_message(int connection_fd, std::string& message) {
-    size_t message_length = message.size();
-
-    //send the size of the message
-    if (send(connection_fd, &message_length, sizeof(message_length), 0) != sizeof(message_length)) {
-        close(connection_fd);
-        throw std::runtime_error("Failed to send message size.");
-    }
-
-    //send the actual message
+void send_message(int connection_fd, Header header, const std::string& path, const std::string& payload) {
+    std::string message = encode_message(header, path, payload);
     size_t total_sent = 0;
-    while (total_sent < message_length) {
-        ssize_t sent = send(connection_fd, message.c_str() + total_sent, message_length - total_sent, 0);
+    while (total_sent < message.size()) {
+        ssize_t sent = send(connection_fd, message.c_str() + total_sent, message.size() - total_sent, 0);
         if (sent <= 0) {
-            close(connection_fd);
             throw std::runtime_error("Failed to send message.");
         }
         total_sent += sent;
     }
 }
 
-std::string recv_message(int connection_fd) {
-    size_t message_size;
-    std::vector<char> buffer(BUFFER_SIZE);
-
-    //receive the message size
+void recv_exact(int connection_fd, char* data, size_t length) {
     size_t total_received = 0;
-    while (total_received < sizeof(message_size)) {
-        ssize_t received = recv(connection_fd, buffer.data() + total_received, sizeof(message_size) - total_received, 0);
+    while (total_received < length) {
+        ssize_t received = recv(connection_fd, data + total_received, length - total_received, 0);
         if (received <= 0) {
-            throw std::runtime_error("Failed to receive message size.");
+            throw std::runtime_error("Failed to receive message.");
         }
         total_received += received;
     }
+}
 
-    //get the message size from the buffer and resize the buffer
-    std::memcpy(&message_size, buffer.data(), sizeof(message_size));
-    buffer.resize(message_size + sizeof(message_size));
+Header recv_header(int connection_fd) {
+    char bytes[HEADER_SIZE];
+    recv_exact(connection_fd, bytes, HEADER_SIZE);
+    Header header = decode_header(bytes);
+    if (header.version != PROTOCOL_VERSION) {
+        throw std::runtime_error("Server speaks another protocol version.");
+    }
+    check_frame_size(header.path_length);
+    return header;
+}
 
-    //receive the message data
-    total_received = sizeof(message_size);
-    while (total_received < sizeof(message_size) + message_size) {
-        ssize_t received = recv(connection_fd, buffer.data() + total_received, sizeof(message_size) + message_size - total_received, 0);
-        if (received <= 0) {
-            throw std::runtime_error("Failed to receive message.");
-        }
-        total_received += received;
+void check_frame_size(uint64_t length) {
+    if (length > MAX_FRAME_SIZE) {
+        throw std::runtime_error("Server sent a message over the size limit.");
     }
+}
 
-    //extract the message data from the buffer
-    std::string message(buffer.data() + sizeof(message_size), buffer.data() + sizeof(message_size) + message_size);
-    return message;
+std::string recv_response(int connection_fd, Header& header) {
+    header = recv_header(connection_fd);
+    check_frame_size(header.payload_length);
+    //responses carry no path, but one is skipped over all the same
+    std::string body(header.path_length + header.payload_length, '\0');
+    recv_exact(connection_fd, body.data(), body.size());
+    return body.substr(header.path_length);
 }
 
-void connection (int connection_fd) {
-    std::string message = recv_message(connection_fd);
-    //handle server via splitting into modes
-    std::string command(message);
-    std::string mode;
-    std::string path;
-    std::string input;
+uint8_t hello(int socket_no) {
+    Header header;
+    header.opcode = OP_HELLO;
+    header.request_id = next_request_id++;
+    send_message(socket_no, header, "", supported_codecs());
 
-    mode = command.substr(0, command.find(' '));  
-    path = command.substr(command.find(' ') + 1);   
+    Header response;
+    std::string payload = recv_response(socket_no, response);
+    if (response.opcode != OP_HELLO || response.status != STATUS_OK) {
+        throw std::runtime_error("Server refused the connection.");
+    }
+    //a server that doesn't compress names no codec
+    return choose_codec(payload);
+}
 
-    //check if the message contains a tilde. if so, it is for the store method
-    size_t tilde_pos = path.find('~');
-    if (tilde_pos != std::string::npos) {
-        input = path.substr(tilde_pos + 1);
-        path = path.substr(0, tilde_pos);
+Reply handle_request(const Request& request) {
+    Reply reply;
+    //handle server via splitting into opcodes
+    const Header& header = request.header;
+    const std::string& path = request.path;
+
+    if (header.opcode == OP_HELLO) {
+        //a client that offered codecs is told which one the connection uses
+        std::string payload;
+        if (!request.payload.empty()) {
+            payload += (char) ((compress_min > 0) ? request.codec : CODEC_NONE);
+        }
+        reply.head = encode_header(response_header(header, STATUS_OK, payload.size())) + payload;
+    } else if (header.opcode == OP_STORE) {
+        //the contents of a store arrive after the request, so it only takes the path's lock once they are in
+        return begin_store(request);
+    } else if (header.opcode == OP_CHECK) {
+        //a file that exists comes back with its metadata
+        Metadata metadata;
+        if (check_path(path, metadata) == STATUS_OK) {
+            std::string payload = encode_metadata(metadata);
+            reply.head = encode_header(response_header(header, STATUS_OK, payload.size())) + payload;
+        } else {
+            reply.head = encode_header(response_header(header, STATUS_NOT_FOUND, 0));
+        }
+    } else if (header.opcode == OP_DELETE) {
+        reply.head = encode_header(response_header(header, delete_path(path), 0));
+    } else if (header.opcode == OP_BATCH) {
+        //each path is handled as a request of its own, taking its lock in turn, and its record goes in the
+        //payload
+        uint8_t opcode;
+        std::vector<std::string> paths;
+        if (!decode_batch(request.payload, opcode, paths) || (opcode != OP_CHECK && opcode != OP_DELETE)) {
+            reply.head = encode_header(response_header(header, STATUS_FAILED, 0));
+            return reply;
+        }
+        std::string records;
+        records.reserve(paths.size() * ((opcode == OP_CHECK) ? 1 + METADATA_SIZE : 1));
+        for (const std::string& batch_path : paths) {
+            if (opcode == OP_CHECK) {
+                Metadata metadata;
+                records += (char) check_path(batch_path, metadata);
+                records += encode_metadata(metadata);
+            } else {
+                records += (char) delete_path(batch_path);
+            }
+        }
+        reply.head = encode_header(response_header(header, STATUS_OK, records.size())) + records;
+    } else if (header.opcode == OP_STATS) {
+        std::string report = stats.report();
+        reply.head = encode_header(response_header(header, STATUS_OK, report.size())) + report;
+    } else if (header.opcode == OP_LOAD) {
+        //without a range, the whole file is loaded
+        Range range;
+        if (request.payload.size() >= RANGE_SIZE) {
+            range = decode_range(request.payload.data());
+        }
+        return load_path(header, path, range, (compress_min > 0) ? request.codec : CODEC_NONE);
+    } else {
+        reply.head = encode_header(response_header(header, STATUS_FAILED, 0));
     }
+    return reply;
+}
 
-    //give extra permissions to store function
-    int fd;
-    if (mode == "CHECK" || mode == "LOAD" || mode == "DELETE") {
+Reply load_path(const Header& header, const std::string& path, Range range, uint8_t codec) {
+    Reply reply;
+    //readers of a file share its lock, and writers wait for everyone else. the lock is held until the
+    //transaction is complete
+    PathLocks::Guard guard(path_locks, path, false);
+
+    //a hot file is served from the cache, as long as it is still the file that was read. every load of it
+    //shares the one buffer, and the file isn't even opened
+    struct stat info;
+    ContentCache::Contents contents;
+    if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+        contents = content_cache.find(path, info);
+    }
+    int fd = -1;
+    if (!contents) {
         fd = open(path.c_str(), O_RDONLY);
-    } else if (mode == "STORE") {
-        fd = open(path.c_str(), O_CREAT | O_WRONLY | O_TRUNC, 0644);
+        if (fd == -1 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+            reply.head = encode_header(response_header(header, STATUS_NOT_FOUND, 0));
+            if (fd != -1) {
+                close(fd);
+            }
+            return reply;
+        }
     }
 
+    //the range is cut to the file. the file's metadata goes first, so the client knows its size up front and
+    //can tell whether it changed since an earlier range
+    uint64_t file_size = info.st_size;
+    range = clamp_range(range, file_size);
+    Metadata metadata;
+    metadata.size = file_size;
+    metadata.mtime_ns = (int64_t) info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    reply.head = encode_header(response_header(header, STATUS_OK, METADATA_SIZE + range.length)) +
+                 encode_metadata(metadata);
+
+    //a small file is read into the cache for the loads after this one
+    if (!contents && file_size <= content_cache.get_max_file()) {
+        std::shared_ptr<std::string> read_contents = std::make_shared<std::string>(file_size, '\0');
+        if (read_fully(fd, read_contents->data(), file_size, 0)) {
+            content_cache.insert(path, info, read_contents);
+            contents = read_contents;
+        }
+    }
 
-    if (mode == "CHECK") {
-        //if file exists, found. if not, it is not found.
-        if (fd == -1) {
-            send_message(connection_fd, NOT_FOUND);
+    //on a connection that settled on a codec, a range that is in memory, or small enough to read into it, goes
+    //out compressed, as long as that makes it smaller
+    if (codec != CODEC_NONE && range.length >= compress_min && (contents || range.length <= MAX_COMPRESSED_LOAD)) {
+        std::string read_range;
+        const char* data = nullptr;
+        if (contents) {
+            data = contents->data() + range.offset;
         } else {
-            send_message(connection_fd, FOUND);
+            read_range.resize(range.length);
+            if (read_fully(fd, read_range.data(), range.length, range.offset)) {
+                data = read_range.data();
+            }
         }
-    } else if (mode == "LOAD") {
-        //check if the file opens, and then send everything
-        if (fd == -1) {
-            send_message(connection_fd, NOT_FOUND);
+        std::shared_ptr<std::string> compressed = std::make_shared<std::string>();
+        if (data && compress(codec, data, range.length, *compressed)) {
+            if (fd != -1) {
+                close(fd);
+            }
+            Header response = response_header(header, STATUS_OK, METADATA_SIZE + compressed->size());
+            set_frame_codec(response, codec);
+            reply.head = encode_header(response) + encode_metadata(metadata);
+            reply.body = compressed;
+            return reply;
+        }
+    }
+    if (contents) {
+        if (fd != -1) {
+            close(fd);
+        }
+        //the whole file goes out as the shared buffer, and a piece of it is copied
+        if (range.length == contents->size()) {
+            reply.body = contents;
         } else {
-            std::vector<char> buffer(BUFFER_SIZE);
-            ssize_t bytes_read;
+            reply.head.append(*contents, range.offset, range.length);
+        }
+        return reply;
+    }
 
-            //eead the file in chunks and send each chunk
-            while ((bytes_read = read(fd, buffer.data(), BUFFER_SIZE)) > 0) {
-                std::string chunk(buffer.data(), bytes_read);
-                send_message(connection_fd, chunk);
-            }
+    //otherwise the range goes straight from the page cache to the socket with sendfile. the reply takes over
+    //the file, and the event loop closes it once it is sent
+    reply.file_fd = fd;
+    reply.file_offset = range.offset;
+    reply.file_length = range.length;
+    return reply;
+}
 
-            if (bytes_read < 0) {
-                std::cerr << "Error reading file: " << std::endl;
-            }
+bool read_fully(int fd, char* buffer, size_t length, off_t offset) {
+    size_t total_read = 0;
+    while (total_read < length) {
+        ssize_t got = pread(fd, buffer + total_read, length - total_read, offset + total_read);
+        if (got <= 0) {
+            return false;
         }
-    } else if (mode == "STORE") {
-        //check if file error
+        total_read += got;
+    }
+    return true;
+}
+
+uint8_t check_path(const std::string& path, Metadata& metadata) {
+    //if file exists, found. if not, it is not found. the answer usually comes from the metadata cache, and
+    //otherwise from a stat, so the file is never opened
+    PathLocks::Guard guard(path_locks, path, false);
+    return metadata_cache.lookup(path, metadata);
+}
+
+uint8_t delete_path(const std::string& path) {
+    //check if file exists, if it does, unlink it (delete)
+    PathLocks::Guard guard(path_locks, path, true);
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        //whatever the caches thought, the file is gone now
+        metadata_cache.invalidate(path);
+        return STATUS_NOT_FOUND;
+    }
+    close(fd);
+    uint8_t status = (unlink(path.c_str()) == 0) ? STATUS_OK : STATUS_FAILED;
+    content_cache.invalidate(path);
+    metadata_cache.invalidate(path);
+    return status;
+}
+
+Reply begin_store(const Request& request) {
+    Reply reply;
+    const Header& header = request.header;
+    const std::string& path = request.path;
+
+    //the contents go to a hidden temporary file in the same directory, so the rename at the end stays on
+    //one filesystem. readers keep seeing the old file until then
+    size_t slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "" : path.substr(0, slash + 1);
+    std::string name = (slash == std::string::npos) ? path : path.substr(slash + 1);
+    std::string temp_path = directory + "." + name + ".p4tmp.XXXXXX";
+
+    int fd = name.empty() ? -1 : mkstemp(temp_path.data());
+    if (fd != -1 && fchmod(fd, 0644) != 0) {
+        close(fd);
+        unlink(temp_path.c_str());
+        fd = -1;
+    }
+    //without a file, the contents are still read so the reply gets through, and then dropped
+    reply.upload_fd = fd;
+    reply.finish = [fd, header, path, temp_path](bool complete) {
+        Reply done;
         if (fd == -1) {
-            send_message(connection_fd, NOT_FOUND);
-        } else {
-            ssize_t bytes_written = write(fd, input.c_str(), input.length());
-            if (bytes_written == -1) {
-                send_message(connection_fd, NOT_FOUND);
-            } else {
-                send_message(connection_fd, FOUND);
-            }
+            done.head = encode_header(response_header(header, STATUS_FAILED, 0));
+            return done;
         }
-    } else if (mode == "DELETE") {
-        //check if file exists, if it does, unlink it (delete)
-        if (fd == -1) {
-            send_message(connection_fd, NOT_FOUND);
-        } else {
-            unlink(path.c_str());
-            send_message(connection_fd, FOUND);
+        //in durable mode the contents reach the disk before they can replace the file, so a crash leaves
+        //either the old file or the whole new one
+        if (complete && durable && !group_commit.sync(fd)) {
+            complete = false;
         }
-    }
+        if (close(fd) != 0) {
+            complete = false;
+        }
+        bool renamed = false;
+        if (complete) {
+            //writers of a file wait for everyone else, as with delete
+            PathLocks::Guard guard(path_locks, path, true);
+            renamed = (rename(temp_path.c_str(), path.c_str()) == 0);
+            complete = renamed;
+            content_cache.invalidate(path);
+            metadata_cache.invalidate(path);
+        }
+        if (!complete) {
+            unlink(temp_path.c_str());
+        }
+        //and the rename reaches it before the client hears the file is stored. the path's lock isn't held for
+        //this, so the wait holds up no one else
+        if (renamed && durable && !sync_directory(path)) {
+            complete = false;
+        }
+        done.head = encode_header(response_header(header, complete ? STATUS_OK : STATUS_FAILED, 0));
+        return done;
+    };
+    return reply;
+}
 
-    //close connection once transaction is complete 
-    close(connection_fd);
+bool sync_directory(const std::string& path) {
+    size_t slash = path.rfind('/');
+    std::string directory = (slash == std::string::npos) ? "." : (slash == 0) ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd == -1) {
+        return false;
+    }
+    bool synced = group_commit.sync(fd);
     close(fd);
+    return synced;
 }
 
-// desc : Connects to server and sends a one-line message
+// desc : Connects to server and sends a request
 // pre  : ip is a vaid ip address and port is a valid port number
 // post : If an error is encountered, a runtime exception is thrown
-void client(in_addr_t ip, in_port_t port, std::string path, std::string mode) {
+void client(in_addr_t ip, in_port_t port, std::string mode, const ClientOptions& options) {
     // Attempt to connect to server through a new socket.
     // Return early if this fails.
     int socket_fd = connect_to(ip,port);
@@ -416,130 +1004,226 @@ void client(in_addr_t ip, in_port_t port, std::string path, std::string mode) {
     if(socket_fd < 0) {
         return;
     }
+    uint8_t codec = hello(socket_fd);
+    if (mode == "stats") {
+        result = print_stats(socket_fd);
+        close(socket_fd);
+        exit(result);
+    }
 
+    //a single path keeps to the plain request, and many go out together
+    const std::vector<std::string>& paths = options.paths;
+    std::string path = paths[0];
     if (mode == "check") {
-        result = check(path, socket_fd);
+        result = (paths.size() == 1) ? check(path, socket_fd) : batch(OP_CHECK, paths, socket_fd);
         close(socket_fd);
         exit(result);
     } else if (mode == "load") {
-        result = load(path, socket_fd);
+        if (!options.directory.empty()) {
+            result = load_all(paths, options.directory, socket_fd);
+        } else if (!options.output.empty()) {
+            result = download(ip, port, path, options, socket_fd);
+        } else {
+            result = load(path, options.range, socket_fd);
+        }
         close(socket_fd);
         exit(result);
     } else if (mode == "store") {
-        result = store(path, socket_fd);
+        result = store(path, codec, socket_fd);
         close(socket_fd);
         exit(result);
     } else if (mode == "delete") {
-        result = delete_fx(path, socket_fd);
+        result = (paths.size() == 1) ? delete_fx(path, socket_fd) : batch(OP_DELETE, paths, socket_fd);
         close(socket_fd);
         exit(result);
     }
 
 }
 
+std::string describe_metadata(const Metadata& metadata) {
+    time_t seconds = metadata.mtime_ns / 1000000000;
+    struct tm local;
+    char modified[64];
+    localtime_r(&seconds, &local);
+    strftime(modified, sizeof(modified), "%Y-%m-%d %H:%M:%S", &local);
+    return std::to_string(metadata.size) + " bytes, modified " + modified;
+}
+
+bool parse_client_options(int argc, char* argv[], int first, ClientOptions& options) {
+    for (int i = first; i < argc; i++) {
+        std::string argument = argv[i];
+        bool has_value = (i + 1 < argc);
+        if (argument == "--manifest" && has_value) {
+            std::ifstream manifest(argv[++i]);
+            if (!manifest) {
+                std::cerr << "Could not open manifest '" << argv[i] << "'." << std::endl;
+                return false;
+            }
+            std::string line;
+            while (std::getline(manifest, line)) {
+                if (!line.empty() && line.back() == '\r') {
+                    line.pop_back();
+                }
+                if (!line.empty()) {
+                    options.paths.push_back(line);
+                }
+            }
+        } else if (argument == "--dir" && has_value) {
+            options.directory = argv[++i];
+        } else if (argument == "--output" && has_value) {
+            options.output = argv[++i];
+        } else if (argument == "--resume") {
+            options.resume = true;
+        } else if (argument == "--parallel" && has_value && atoi(argv[i + 1]) > 0) {
+            options.parallel = atoi(argv[++i]);
+        } else if (argument == "--offset" && has_value) {
+            options.range.offset = strtoull(argv[++i], nullptr, 10);
+        } else if (argument == "--length" && has_value) {
+            options.range.length = strtoull(argv[++i], nullptr, 10);
+        } else if (argument.rfind("--", 0) == 0) {
+            return false;
+        } else {
+            options.paths.push_back(argument);
+        }
+    }
+    return true;
+}
+
+bool has_load_options(const ClientOptions& options) {
+    return !options.directory.empty() || !options.output.empty() || options.resume || options.parallel != 1 ||
+           options.range.offset != 0 || options.range.length != UINT64_MAX;
+}
+
+
 // desc : Listens on an arbitrary port (announced through stdout)
-//        for connections, recieving messages as 32-bit string
-//        lengths followed my a sequence of characters matching that
-//        length.
+//        for connections, recieving requests in the protocol of
+//        protocol.h, any number per connection.
 // pre  : None
 // post : If a listening socket cannot be set up, a runtime exception
 //        is thrown. If a connection fails or disconnects early, the
 //        error is announced but the server continues operation.
-void server() {
-
-    // Make an arbitrary socket to listen through
-    int socket_fd = arbitrary_socket();
-    int port = get_port(socket_fd);
-
-    std::cout << "Setup server at port "<< port << std::endl;
+void server(int loops, int threads, size_t queue_size, uint64_t max_frame) {
+    // A client that disconnects early must not take the server
+    // down with SIGPIPE; the failed send is reported instead
+    signal(SIGPIPE, SIG_IGN);
+
+    // One event loop per core by default. Each gets its own
+    // listening socket on the same port.
+    if (loops <= 0) {
+        loops = std::thread::hardware_concurrency();
+    }
+    if (loops <= 0) {
+        loops = 1;
+    }
+    std::vector<int> socket_fds;
+    socket_fds.push_back(reuse_port_socket(0));
+    int port = get_port(socket_fds[0]);
+    for (int i = 1; i < loops; i++) {
+        socket_fds.push_back(reuse_port_socket(port));
+    }
 
     // Tell OS to start listening at port for its set protocol
-    // (in this case, TCP IP), with a waiting queue of size 1.
+    // (in this case, TCP IP), with a waiting queue of 1024.
     // Additional connection requests that cannot fit in the
     // queue will be refused.
-    int status = listen(socket_fd,1024);
-    if( status < 0 ) {
-        std::cout << "Listening failed." << std::endl;
-        return;
+    for (int socket_fd : socket_fds) {
+        int status = listen(socket_fd,1024);
+        if( status < 0 ) {
+            std::cout << "Listening failed." << std::endl;
+            return;
+        }
     }
 
-    // A receptacle to store information about sockets we will
-    // accept connections through
-    sockaddr_storage storage;
-    socklen_t socket_len = sizeof(sockaddr_storage);
-    while(true){
-        
-        // Wait until a connection request arrives at the port
-        int connection_fd = accept(
-            socket_fd,
-            (sockaddr*)&storage,
-            &socket_len
-        );
+    WorkerPool pool(threads, queue_size);
+    std::vector<Reactor*> reactors;
+    for (int socket_fd : socket_fds) {
+        reactors.push_back(new Reactor(socket_fd, pool, handle_request, stats, max_frame));
+    }
+    std::cout << "Setup server at port "<< port << " with " << loops << " event loops and "
+              << pool.get_threads() << " workers" << std::endl;
 
-        // Ignore failures. Clients can do weird things sometimes, and
-        // it's not a good idea to simply crash whenever that happens.
-        if(connection_fd < 0){
-            std::cout << "Could not accept connection.\n";
-            continue;
-        }
-        connection(connection_fd);
-        /*
-        std::thread connect(connection, connection_fd);
-        connect.detach();
-        */
+    // The calling thread runs the last loop. None of them
+    // return; the server runs until it is interrupted.
+    for (int i = 0; i + 1 < loops; i++) {
+        std::thread(&Reactor::run, reactors[i]).detach();
     }
+    reactors.back()->run();
 }
 
 
 int check (std::string path, int socket_no) { 
-    std::string message = "CHECK " + path;
+    Header header;
+    header.opcode = OP_CHECK;
+    header.request_id = next_request_id++;
 
     //send and receive
-    send_message(socket_no, message);
-    std::string received_message = recv_message(socket_no);
+    send_message(socket_no, header, path, "");
+    Header response;
+    std::string payload = recv_response(socket_no, response);
 
     //if the file path is not found, return 1, if not return 0
-    if (received_message != "FOUND") {
+    if (response.status != STATUS_OK) {
         std::cerr << "\nFile path not found.\n";
         return 1;
     } else {
         std::cout << "\nFile path found!\n";
+        if (payload.size() >= METADATA_SIZE) {
+            std::cout << describe_metadata(decode_metadata(payload.data())) << "\n";
+        }
         return 0;
     }
 }
 
-int load (std::string path, int socket_no) {
+int load (std::string path, Range range, int socket_no) {
     //while there are things to read, write to cout (print it)
-    std::string message = "LOAD " + path;   
-    send_message(socket_no, message);
-    std::string received_message = recv_message(socket_no);
-
-    if (received_message == "NOT_FOUND") {
+    Header header;
+    header.opcode = OP_LOAD;
+    header.request_id = next_request_id++;
+    send_message(socket_no, header, path, encode_range(range));
+
+    Header response;
+    Metadata metadata;
+    uint64_t remaining;
+    if (recv_load_response(socket_no, response, metadata, remaining) != STATUS_OK) {
         std::cerr << "\nFile path not found.\n";
         return 1;
-    } else {
-        received_message.pop_back();
-        std::cout << received_message;
-        std::cout << std::endl;
-        return 0;
     }
+
+    //the contents are passed along a bounded chunk at a time, so a large file never sits in memory whole
+    uint64_t expected = clamp_range(range, metadata.size).length;
+    bool received = recv_contents(socket_no, response, remaining, expected, [](const char* data, size_t length) {
+        return (bool) std::cout.write(data, length);
+    });
+    std::cout.flush();
+    if (!received) {
+        std::cerr << "\nFailed to load the file.\n";
+        return 1;
+    }
+    return 0;
 }
 
-int store(std::string path, int socket_no) {
+int store(std::string path, uint8_t codec, int socket_no) {
     std::cout << "Enter the content to store (Ctrl+D to end input):\n";
-    std::string input;
-    std::string line;
-    while (std::getline(std::cin, line)) {
-        input += line + '\n'; 
+    Header header;
+    header.opcode = OP_STORE;
+    header.request_id = next_request_id++;
+    send_message(socket_no, header, path, "");
+
+    //the input is sent a bounded chunk at a time as it is read, so it never sits in memory whole. the last
+    //DATA message, empty or not, is flagged FIN
+    std::string chunk(MAX_DATA_SIZE, '\0');
+    size_t total_sent = 0;
+    while (std::cin.read(chunk.data(), chunk.size()) || std::cin.gcount() > 0) {
+        send_data(socket_no, header.request_id, codec, chunk.data(), std::cin.gcount(), false);
+        total_sent += std::cin.gcount();
     }
+    send_data(socket_no, header.request_id, codec, "", 0, true);
+    std::cout << std::endl << std::endl << "You have inputted " << total_sent << " bytes.";
 
-    std::string message = "STORE " + path + '~' + input;
-    std::cout << std::endl << std::endl << "You have inputted: " << input;
+    Header response;
+    recv_response(socket_no, response);
 
-    send_message(socket_no, message);
-    std::string received_message = recv_message(socket_no);
-
-    if (received_message == "FOUND") {
+    if (response.status == STATUS_OK) {
         std::cout << "\nSuccessfully stored data.\n";
         return 0;
     } else {
@@ -548,13 +1232,46 @@ int store(std::string path, int socket_no) {
     }
 }
 
+void send_data(int socket_no, uint32_t request_id, uint8_t codec, const char* data, size_t length, bool fin) {
+    Header header;
+    header.opcode = OP_DATA;
+    header.request_id = request_id;
+    header.flags = fin ? FLAG_FIN : 0;
+    std::string compressed;
+    if (codec != CODEC_NONE && length >= COMPRESS_MIN_SIZE && compress(codec, data, length, compressed)) {
+        set_frame_codec(header, codec);
+        send_message(socket_no, header, "", compressed);
+    } else {
+        send_message(socket_no, header, "", std::string(data, length));
+    }
+}
+
+int print_stats(int socket_no) {
+    Header header;
+    header.opcode = OP_STATS;
+    header.request_id = next_request_id++;
+    send_message(socket_no, header, "", "");
+
+    Header response;
+    std::string report = recv_response(socket_no, response);
+    if (response.status != STATUS_OK) {
+        std::cerr << "\nServer did not send its stats.\n";
+        return 1;
+    }
+    std::cout << report;
+    return 0;
+}
+
 int delete_fx(std::string path, int socket_no) {
-    std::string message = "DELETE " + path;
+    Header header;
+    header.opcode = OP_DELETE;
+    header.request_id = next_request_id++;
 
-    send_message(socket_no, message);
-    std::string received_message = recv_message(socket_no);
+    send_message(socket_no, header, path, "");
+    Header response;
+    recv_response(socket_no, response);
 
-    if (received_message == "FOUND") {
+    if (response.status == STATUS_OK) {
         std::cout << "\nSuccessfully deleted file.\n";
         return 0;
     } else {
@@ -562,4 +1279,573 @@ int delete_fx(std::string path, int socket_no) {
         return 1;
     }
     return 0;
-} 
\ No newline at end of file
+}
+
+int batch(uint8_t opcode, const std::vector<std::string>& paths, int socket_no) {
+    //the results of each request are placed by the index of its first path, since they come back in any order.
+    //checks report metadata along with each status
+    std::vector<uint8_t> statuses(paths.size(), STATUS_FAILED);
+    std::vector<Metadata> metadata(paths.size());
+    size_t record_size = (opcode == OP_CHECK) ? 1 + METADATA_SIZE : 1;
+    std::unordered_map<uint32_t, size_t> first_path;
+    size_t next_path = 0;
+    while (next_path < paths.size() || !first_path.empty()) {
+        //keep the pipeline full, then wait for whichever request finishes first
+        while (next_path < paths.size() && first_path.size() < MAX_PIPELINED) {
+            size_t count = std::min(BATCH_PATHS, paths.size() - next_path);
+            std::vector<std::string> group(paths.begin() + next_path, paths.begin() + next_path + count);
+            Header header;
+            header.opcode = OP_BATCH;
+            header.request_id = next_request_id++;
+            send_message(socket_no, header, "", encode_batch(opcode, group));
+            first_path[header.request_id] = next_path;
+            next_path += count;
+        }
+        Header response;
+        std::string results = recv_response(socket_no, response);
+        auto found = first_path.find(response.request_id);
+        if (found == first_path.end()) {
+            throw std::runtime_error("Server answered a request that was not made.");
+        }
+        if (response.status == STATUS_OK) {
+            for (size_t i = 0; (i + 1) * record_size <= results.size() && found->second + i < paths.size(); i++) {
+                statuses[found->second + i] = results[i * record_size];
+                if (opcode == OP_CHECK) {
+                    metadata[found->second + i] = decode_metadata(results.data() + i * record_size + 1);
+                }
+            }
+        }
+        first_path.erase(found);
+    }
+
+    int result = 0;
+    for (size_t i = 0; i < paths.size(); i++) {
+        if (statuses[i] == STATUS_OK && opcode == OP_CHECK) {
+            std::cout << "found     " << paths[i] << " (" << describe_metadata(metadata[i]) << ")\n";
+        } else if (statuses[i] == STATUS_OK) {
+            std::cout << "deleted   " << paths[i] << "\n";
+        } else if (statuses[i] == STATUS_NOT_FOUND) {
+            std::cout << "not found " << paths[i] << "\n";
+            result = 1;
+        } else {
+            std::cout << "failed    " << paths[i] << "\n";
+            result = 1;
+        }
+    }
+    std::cout.flush();
+    return result;
+}
+
+int load_all(const std::vector<std::string>& paths, std::string directory, int socket_no) {
+    std::unordered_map<uint32_t, size_t> requested;
+    size_t next_path = 0;
+    int result = 0;
+    while (next_path < paths.size() || !requested.empty()) {
+        //keep the pipeline full, then take whichever file comes back first
+        while (next_path < paths.size() && requested.size() < MAX_PIPELINED) {
+            Header header;
+            header.opcode = OP_LOAD;
+            header.request_id = next_request_id++;
+            send_message(socket_no, header, paths[next_path], "");
+            requested[header.request_id] = next_path++;
+        }
+        Header response = recv_header(socket_no);
+        auto found = requested.find(response.request_id);
+        if (found == requested.end()) {
+            throw std::runtime_error("Server answered a request that was not made.");
+        }
+        const std::string& path = paths[found->second];
+        requested.erase(found);
+        std::string skipped(response.path_length, '\0');
+        recv_exact(socket_no, skipped.data(), skipped.size());
+        //the file's metadata comes ahead of its contents
+        uint64_t remaining = response.payload_length;
+        Metadata metadata;
+        if (response.status == STATUS_OK && remaining >= METADATA_SIZE) {
+            char bytes[METADATA_SIZE];
+            recv_exact(socket_no, bytes, METADATA_SIZE);
+            metadata = decode_metadata(bytes);
+            remaining -= METADATA_SIZE;
+        }
+
+        //files are saved at their own path under the directory, and never above it
+        std::filesystem::path local = (std::filesystem::path(directory) /
+                                       std::filesystem::path(path).relative_path()).lexically_normal();
+        bool inside = !std::filesystem::path(path).relative_path().lexically_normal().string().starts_with("..");
+        std::ofstream file;
+        if (response.status == STATUS_OK && inside) {
+            std::error_code error;
+            std::filesystem::create_directories(local.parent_path(), error);
+            file.open(local, std::ios::binary | std::ios::trunc);
+        }
+
+        //the contents are read off the connection either way, so the responses after them line up
+        bool received = recv_contents(socket_no, response, remaining, metadata.size, [&file](const char* data, size_t length) {
+            file.write(data, length);
+            return true;
+        });
+
+        if (response.status == STATUS_NOT_FOUND) {
+            std::cout << "not found " << path << "\n";
+            result = 1;
+        } else if (response.status != STATUS_OK || !received || !file.is_open() || !file.flush()) {
+            std::cout << "failed    " << path << "\n";
+            result = 1;
+        } else {
+            std::cout << "loaded    " << path << " -> " << local.string() << "\n";
+        }
+    }
+    std::cout.flush();
+    return result;
+}
+
+uint8_t recv_load_response(int socket_no, Header& response, Metadata& metadata, uint64_t& length) {
+    response = recv_header(socket_no);
+    std::string skipped(response.path_length, '\0');
+    recv_exact(socket_no, skipped.data(), skipped.size());
+    if (response.status != STATUS_OK || response.payload_length < METADATA_SIZE) {
+        //nothing useful follows a failure, but it is read anyway
+        check_frame_size(response.payload_length);
+        std::string rest(response.payload_length, '\0');
+        recv_exact(socket_no, rest.data(), rest.size());
+        return (response.status == STATUS_OK) ? STATUS_FAILED : response.status;
+    }
+    char bytes[METADATA_SIZE];
+    recv_exact(socket_no, bytes, METADATA_SIZE);
+    metadata = decode_metadata(bytes);
+    length = response.payload_length - METADATA_SIZE;
+    return STATUS_OK;
+}
+
+bool recv_contents(int socket_no, const Header& response, uint64_t length, uint64_t expected,
+                   const std::function<bool(const char*, size_t)>& write) {
+    uint8_t codec = frame_codec(response);
+    if (codec != CODEC_NONE) {
+        //compressed contents come whole, and must expand to exactly the range asked for
+        check_frame_size(length);
+        std::string compressed(length, '\0');
+        recv_exact(socket_no, compressed.data(), compressed.size());
+        std::string contents;
+        if (!decompress(codec, compressed.data(), compressed.size(), contents, expected) ||
+            contents.size() != expected) {
+            return false;
+        }
+        for (size_t offset = 0; offset < contents.size(); offset += MAX_DATA_SIZE) {
+            if (!write(contents.data() + offset, std::min(MAX_DATA_SIZE, contents.size() - offset))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    //once a write fails, the rest is only read off the socket
+    bool written = (length == expected);
+    std::vector<char> buffer(64 * 1024);
+    while (length > 0) {
+        size_t chunk = std::min(length, (uint64_t) buffer.size());
+        recv_exact(socket_no, buffer.data(), chunk);
+        written = written && write(buffer.data(), chunk);
+        length -= chunk;
+    }
+    return written;
+}
+
+int download(in_addr_t ip, in_port_t port, std::string path, const ClientOptions& options, int socket_no) {
+    //the server's metadata says how much there is to fetch, and whether earlier progress is for the same file.
+    //an empty LOAD asks for it, since CHECK may answer from a cache that is a moment behind
+    Header header;
+    header.opcode = OP_LOAD;
+    header.request_id = next_request_id++;
+    Range empty;
+    empty.length = 0;
+    send_message(socket_no, header, path, encode_range(empty));
+    Header response;
+    DownloadProgress progress;
+    uint64_t length;
+    if (recv_load_response(socket_no, response, progress.metadata, length) != STATUS_OK) {
+        std::cerr << "\nFile path not found.\n";
+        return 1;
+    }
+
+    progress.path = options.output + ".p4part";
+    progress.range = clamp_range(options.range, progress.metadata.size);
+
+    bool resuming = options.resume && read_progress(progress);
+    if (options.resume && !resuming) {
+        std::cerr << "No progress to resume for '" << options.output << "'; starting over.\n";
+    }
+    if (!resuming) {
+        //the range is split evenly, with every connection given at least one byte
+        uint64_t parts = std::max<uint64_t>(1, std::min<uint64_t>(options.parallel, progress.range.length));
+        for (uint64_t i = 0; i < parts; i++) {
+            progress.parts.push_back({ progress.range.length * i / parts, progress.range.length * (i + 1) / parts });
+        }
+    }
+
+    int fd = open(options.output.c_str(), O_WRONLY | O_CREAT | (resuming ? 0 : O_TRUNC), 0644);
+    if (fd == -1 || ftruncate(fd, progress.range.length) != 0) {
+        std::cerr << "Could not open '" << options.output << "'.\n";
+        if (fd != -1) {
+            close(fd);
+        }
+        return 1;
+    }
+    {
+        std::lock_guard lock(progress.mut);
+        save_progress(progress);
+    }
+
+    //each part gets a connection of its own; the first one uses this one
+    std::atomic<bool> failed = false;
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < progress.parts.size(); i++) {
+        threads.emplace_back([&, i]() {
+            try {
+                int part_socket = connect_to(ip, port);
+                hello(part_socket);
+                fetch_part(part_socket, path, fd, progress, i);
+                close(part_socket);
+            } catch (std::exception& e) {
+                std::cerr << e.what() << "\n";
+                failed = true;
+            }
+        });
+    }
+    try {
+        fetch_part(socket_no, path, fd, progress, 0);
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        failed = true;
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    close(fd);
+
+    if (failed) {
+        std::cerr << "\nDownload interrupted. Run it again with --resume to carry on.\n";
+        return 1;
+    }
+    unlink(progress.path.c_str());
+    std::cout << "\nSaved " << progress.range.length << " bytes to " << options.output << ".\n";
+    return 0;
+}
+
+void fetch_part(int socket_no, std::string path, int fd, DownloadProgress& progress, size_t index) {
+    DownloadPart part;
+    {
+        std::lock_guard lock(progress.mut);
+        part = progress.parts[index];
+    }
+    if (part.next >= part.end) {
+        return;
+    }
+    Header header;
+    header.opcode = OP_LOAD;
+    header.request_id = next_request_id++;
+    Range range;
+    range.offset = progress.range.offset + part.next;
+    range.length = part.end - part.next;
+    send_message(socket_no, header, path, encode_range(range));
+
+    Header response;
+    Metadata metadata;
+    uint64_t remaining;
+    if (recv_load_response(socket_no, response, metadata, remaining) != STATUS_OK) {
+        throw std::runtime_error("File path not found.");
+    }
+    if (metadata.size != progress.metadata.size || metadata.mtime_ns != progress.metadata.mtime_ns) {
+        throw std::runtime_error("File changed on the server during the download.");
+    }
+
+    //progress is recorded every few MiB, so little is fetched twice after an interruption
+    const uint64_t SAVE_EVERY = 4 << 20;
+    uint64_t unsaved = 0;
+    bool written = recv_contents(socket_no, response, remaining, range.length, [&](const char* data, size_t length) {
+        if (length > part.end - part.next || pwrite(fd, data, length, part.next) != (ssize_t) length) {
+            return false;
+        }
+        part.next += length;
+        unsaved += length;
+        if (unsaved >= SAVE_EVERY || part.next == part.end) {
+            std::lock_guard lock(progress.mut);
+            progress.parts[index].next = part.next;
+            save_progress(progress);
+            unsaved = 0;
+        }
+        return true;
+    });
+    if (!written || part.next != part.end) {
+        throw std::runtime_error("Failed to save the download.");
+    }
+}
+
+void save_progress(DownloadProgress& progress) {
+    //one line for the file and range, and one per part
+    std::string temp_path = progress.path + ".tmp";
+    {
+        std::ofstream file(temp_path, std::ios::trunc);
+        file << progress.metadata.size << ' ' << progress.metadata.mtime_ns << ' '
+             << progress.range.offset << ' ' << progress.range.length << '\n';
+        for (const DownloadPart& part : progress.parts) {
+            file << part.next << ' ' << part.end << '\n';
+        }
+    }
+    rename(temp_path.c_str(), progress.path.c_str());
+}
+
+bool read_progress(DownloadProgress& progress) {
+    std::ifstream file(progress.path);
+    uint64_t size, offset, length;
+    int64_t mtime_ns;
+    if (!(file >> size >> mtime_ns >> offset >> length) || size != progress.metadata.size ||
+        mtime_ns != progress.metadata.mtime_ns || offset != progress.range.offset ||
+        length != progress.range.length) {
+        return false;
+    }
+    DownloadPart part;
+    while (file >> part.next >> part.end) {
+        if (part.next > part.end || part.end > length) {
+            return false;
+        }
+        progress.parts.push_back(part);
+    }
+    return !progress.parts.empty();
+}
+
+bool parse_bench_options(int argc, char* argv[], int first, BenchOptions& options) {
+    for (int i = first; i + 1 < argc; i += 2) {
+        std::string option = argv[i];
+        std::string value = argv[i + 1];
+        if (option == "--connections" && atoi(value.c_str()) > 0) {
+            options.connections = atoi(value.c_str());
+        } else if (option == "--duration" && atoi(value.c_str()) > 0) {
+            options.duration_s = atoi(value.c_str());
+        } else if (option == "--rate" && atof(value.c_str()) >= 0) {
+            options.rate = atof(value.c_str());
+        } else if (option == "--size") {
+            options.file_size = strtoull(value.c_str(), nullptr, 10);
+        } else if (option == "--files" && atoi(value.c_str()) > 0) {
+            options.files = atoi(value.c_str());
+        } else if (option == "--prefix" && !value.empty()) {
+            options.prefix = value;
+        } else if (option == "--mix") {
+            //comma-separated name=weight pairs, e.g. check=90,load=10
+            const std::unordered_map<std::string, uint8_t> names = { { "check", OP_CHECK }, { "load", OP_LOAD },
+                                                                    { "store", OP_STORE }, { "delete", OP_DELETE } };
+            options.mix.clear();
+            std::stringstream pairs(value);
+            std::string pair;
+            while (std::getline(pairs, pair, ',')) {
+                size_t equals = pair.find('=');
+                auto found = names.find(pair.substr(0, equals));
+                if (equals == std::string::npos || found == names.end() || atoi(pair.c_str() + equals + 1) < 0) {
+                    return false;
+                }
+                options.mix.push_back({ found->second, atoi(pair.c_str() + equals + 1) });
+            }
+            int total = 0;
+            for (auto& [opcode, weight] : options.mix) {
+                total += weight;
+            }
+            if (total == 0) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    //options come in pairs
+    return (argc - first) % 2 == 0;
+}
+
+int bench(in_addr_t ip, in_port_t port, const BenchOptions& options) {
+    //every STORE sends the same contents. they're random, so compression doesn't flatter the numbers
+    std::string contents(options.file_size, '\0');
+    std::mt19937_64 random(12345);
+    for (char& byte : contents) {
+        byte = (char) random();
+    }
+    std::vector<std::string> paths;
+    for (int i = 0; i < options.files; i++) {
+        paths.push_back(options.prefix + std::to_string(i));
+    }
+
+    //the files are stored first, so CHECKs and LOADs find them
+    int socket_fd;
+    uint8_t codec;
+    try {
+        socket_fd = connect_to(ip, port);
+        codec = hello(socket_fd);
+        for (const std::string& path : paths) {
+            uint64_t bytes = 0;
+            if (bench_request(socket_fd, OP_STORE, path, contents, codec, bytes) != STATUS_OK) {
+                throw std::runtime_error("Could not store '" + path + "'.");
+            }
+        }
+    } catch (std::exception& e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+
+    std::unordered_map<uint8_t, std::unique_ptr<BenchResults>> results;
+    for (auto& [opcode, weight] : options.mix) {
+        results[opcode] = std::make_unique<BenchResults>();
+    }
+    std::cout << "Running " << options.connections << " connections for " << options.duration_s << "s at "
+              << ((options.rate > 0) ? std::to_string((int64_t) options.rate) + " requests/s" : "full speed")
+              << " over " << options.files << " files of " << options.file_size << " bytes" << std::endl;
+
+    //the clients start together, a moment from now, so none of them is timed while the others connect
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(100);
+    auto deadline = start + std::chrono::seconds(options.duration_s);
+    std::vector<std::thread> threads;
+    for (int i = 0; i < options.connections; i++) {
+        threads.emplace_back(bench_client, ip, port, std::cref(options), i, std::cref(contents), start, deadline,
+                             std::ref(results));
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    //throughput, and each kind of request's latency from when it was due to be sent
+    uint64_t total = 0;
+    uint64_t total_bytes = 0;
+    std::cout << "\nrequest  count      per_s   not_found  errors  p50_us   p90_us   p99_us   p999_us  max_us\n";
+    for (auto& [opcode, weight] : options.mix) {
+        BenchResults& result = *results[opcode];
+        Histogram& latency = result.latency_us;
+        const char* name = (opcode == OP_CHECK) ? "check" : (opcode == OP_LOAD) ? "load"
+                         : (opcode == OP_STORE) ? "store" : "delete";
+        char line[256];
+        snprintf(line, sizeof(line), "%-8s %-10lu %-10.0f %-10lu %-7lu %-8lu %-8lu %-8lu %-8lu %lu\n", name,
+                 latency.get_count(), latency.get_count() / elapsed, result.not_found.load(), result.errors.load(),
+                 latency.percentile(0.5), latency.percentile(0.9), latency.percentile(0.99),
+                 latency.percentile(0.999), latency.get_max());
+        std::cout << line;
+        total += latency.get_count();
+        total_bytes += result.bytes;
+    }
+    std::cout << "\n" << total << " requests in " << elapsed << "s: " << (int64_t) (total / elapsed)
+              << " requests/s, " << total_bytes / elapsed / (1 << 20) << " MiB/s of file contents" << std::endl;
+
+    //the files are cleaned up in BATCH DELETEs
+    for (size_t first = 0; first < paths.size(); first += BATCH_PATHS) {
+        std::vector<std::string> part(paths.begin() + first,
+                                      paths.begin() + std::min(paths.size(), first + BATCH_PATHS));
+        Header header;
+        header.opcode = OP_BATCH;
+        header.request_id = next_request_id++;
+        send_message(socket_fd, header, "", encode_batch(OP_DELETE, part));
+        Header response;
+        recv_response(socket_fd, response);
+    }
+    close(socket_fd);
+    return 0;
+}
+
+void bench_client(in_addr_t ip, in_port_t port, const BenchOptions& options, int index, const std::string& contents,
+                  std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point deadline,
+                  std::unordered_map<uint8_t, std::unique_ptr<BenchResults>>& results) {
+    int socket_fd;
+    uint8_t codec;
+    try {
+        socket_fd = connect_to(ip, port);
+        codec = hello(socket_fd);
+    } catch (std::exception& e) {
+        std::cerr << "Client " << index << ": " << e.what() << "\n";
+        return;
+    }
+
+    std::mt19937_64 random(index + 1);
+    std::vector<int> weights;
+    for (auto& [opcode, weight] : options.mix) {
+        weights.push_back(weight);
+    }
+    std::discrete_distribution<size_t> pick_opcode(weights.begin(), weights.end());
+    std::uniform_int_distribution<int> pick_file(0, options.files - 1);
+
+    //with a rate, requests are due on a fixed schedule, the connections' turns spread evenly, and each one's
+    //latency runs from when it was due rather than when it was sent. a stalled server then shows up in the
+    //latency of every request it held up, instead of just the one it stalled (coordinated omission)
+    std::chrono::nanoseconds interval(0);
+    if (options.rate > 0) {
+        interval = std::chrono::nanoseconds((int64_t) (1e9 * options.connections / options.rate));
+    }
+    auto due = start + interval * index / options.connections;
+    while (due < deadline) {
+        std::this_thread::sleep_until(due);
+        auto sent = std::chrono::steady_clock::now();
+        if (interval.count() == 0) {
+            //without a schedule, a request is due when it is sent
+            due = sent;
+            if (due >= deadline) {
+                break;
+            }
+        }
+
+        uint8_t opcode = options.mix[pick_opcode(random)].first;
+        std::string path = options.prefix + std::to_string(pick_file(random));
+        BenchResults& result = *results.at(opcode);
+        uint64_t bytes = 0;
+        uint8_t status;
+        try {
+            status = bench_request(socket_fd, opcode, path, contents, codec, bytes);
+        } catch (std::exception& e) {
+            std::cerr << "Client " << index << ": " << e.what() << "\n";
+            result.errors++;
+            break;
+        }
+        auto done = std::chrono::steady_clock::now();
+        result.latency_us.record(std::chrono::duration_cast<std::chrono::microseconds>(done - due).count());
+        result.bytes += bytes;
+        if (status == STATUS_NOT_FOUND) {
+            result.not_found++;
+        } else if (status != STATUS_OK) {
+            result.errors++;
+        }
+        due += interval;
+    }
+    close(socket_fd);
+}
+
+uint8_t bench_request(int socket_no, uint8_t opcode, const std::string& path, const std::string& contents,
+                      uint8_t codec, uint64_t& bytes) {
+    Header header;
+    header.opcode = opcode;
+    header.request_id = next_request_id++;
+    send_message(socket_no, header, path, "");
+
+    Header response;
+    if (opcode == OP_STORE) {
+        for (size_t offset = 0; offset < contents.size(); offset += MAX_DATA_SIZE) {
+            send_data(socket_no, header.request_id, codec, contents.data() + offset,
+                      std::min(MAX_DATA_SIZE, contents.size() - offset), false);
+        }
+        send_data(socket_no, header.request_id, codec, "", 0, true);
+        recv_response(socket_no, response);
+        if (response.status == STATUS_OK) {
+            bytes += contents.size();
+        }
+    } else if (opcode == OP_LOAD) {
+        Metadata metadata;
+        uint64_t length;
+        if (recv_load_response(socket_no, response, metadata, length) == STATUS_OK) {
+            //a body that comes back short or won't expand is an error, and its bytes don't count
+            uint64_t received = 0;
+            bool complete = recv_contents(socket_no, response, length, metadata.size,
+                                          [&received](const char*, size_t length) {
+                received += length;
+                return true;
+            });
+            if (!complete) {
+                return STATUS_FAILED;
+            }
+            bytes += received;
+        }
+    } else {
+        recv_response(socket_no, response);
+    }
+    return response.status;
+}
@@ -0,0 +1,55 @@
+#include "path_locks.h"
+#include <filesystem>
+
+// Returns the entry for the input path, counting the
+// caller as one of its users
+PathLocks::Entry *PathLocks::acquire(const std::string& path){
+    std::lock_guard lock(mut);
+    Entry *&entry = entries[path];
+    if( entry == nullptr ){
+        entry = new Entry();
+    }
+    entry->users++;
+    return entry;
+}
+
+// Stops counting the caller as a user of the entry,
+// removing it once nobody uses it
+void PathLocks::release(const std::string& path, Entry *entry){
+    std::lock_guard lock(mut);
+    entry->users--;
+    if( entry->users == 0 ){
+        entries.erase(path);
+        delete entry;
+    }
+}
+
+// Returns the key a path is locked under. Spellings of
+// the same path such as "a/../b" and "./b" share a key.
+std::string PathLocks::key(const std::string& path){
+    return std::filesystem::path(path).lexically_normal().string();
+}
+
+// Constructor: Waits for and takes the lock on path
+PathLocks::Guard::Guard(PathLocks& locks, const std::string& path, bool exclusive)
+    : locks(locks)
+    , path(PathLocks::key(path))
+    , entry(locks.acquire(this->path))
+    , exclusive(exclusive)
+{
+    if( exclusive ){
+        entry->lock.lock();
+    } else {
+        entry->lock.lock_shared();
+    }
+}
+
+// Destructor: Releases the lock
+PathLocks::Guard::~Guard(){
+    if( exclusive ){
+        entry->lock.unlock();
+    } else {
+        entry->lock.unlock_shared();
+    }
+    locks.release(path, entry);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+///////////////////////////////////////////////////////////
+// Reader/writer locks on file paths, so requests for the
+// same file are ordered (a STORE or DELETE waits for every
+// LOAD of that file to finish, and the other way around)
+// while requests for different files run side by side.
+// A path's lock only exists while someone holds or waits
+// for it, so the table stays as small as the number of
+// files in use.
+///////////////////////////////////////////////////////////
+class PathLocks {
+
+    struct Entry {
+        std::shared_mutex lock;
+        int               users = 0;
+    };
+
+    std::mutex                              mut;
+    std::unordered_map<std::string, Entry*> entries;
+
+    // Returns the entry for the input path, counting the
+    // caller as one of its users
+    Entry *acquire(const std::string& path);
+
+    // Stops counting the caller as a user of the entry,
+    // removing it once nobody uses it
+    void release(const std::string& path, Entry *entry);
+
+    public:
+
+    ///////////////////////////////////////////////////////
+    // Holds the lock on one path for as long as it exists:
+    // shared for reading, exclusive for writing.
+    ///////////////////////////////////////////////////////
+    class Guard {
+
+        PathLocks  &locks;
+        std::string path;
+        Entry      *entry;
+        bool        exclusive;
+
+        public:
+
+        // Constructor: Waits for and takes the lock on path
+        Guard(PathLocks& locks, const std::string& path, bool exclusive);
+
+        // Destructor: Releases the lock
+        ~Guard();
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+
+    };
+
+    // Returns the key a path is locked under. Spellings of
+    // the same path such as "a/../b" and "./b" share a key.
+    static std::string key(const std::string& path);
+
+};
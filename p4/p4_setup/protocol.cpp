@@ -0,0 +1,152 @@
+#include "protocol.h"
+#include <arpa/inet.h>
+#include <endian.h>
+#include <cstring>
+#include <algorithm>
+
+// Returns the header encoded for the wire
+std::string encode_header(const Header& header){
+    std::string bytes(HEADER_SIZE, '\0');
+    uint32_t request_id     = htonl(header.request_id);
+    uint32_t path_length    = htonl(header.path_length);
+    uint64_t payload_length = htobe64(header.payload_length);
+    bytes[0] = header.version;
+    bytes[1] = header.opcode;
+    bytes[2] = header.flags;
+    bytes[3] = header.status;
+    std::memcpy(&bytes[4],  &request_id,     4);
+    std::memcpy(&bytes[8],  &path_length,    4);
+    std::memcpy(&bytes[12], &payload_length, 8);
+    return bytes;
+}
+
+// Returns the header held in the first HEADER_SIZE bytes
+// of the input
+Header decode_header(const char *bytes){
+    Header header;
+    header.version = bytes[0];
+    header.opcode  = bytes[1];
+    header.flags   = bytes[2];
+    header.status  = bytes[3];
+    std::memcpy(&header.request_id,     &bytes[4],  4);
+    std::memcpy(&header.path_length,    &bytes[8],  4);
+    std::memcpy(&header.payload_length, &bytes[12], 8);
+    header.request_id     = ntohl(header.request_id);
+    header.path_length    = ntohl(header.path_length);
+    header.payload_length = be64toh(header.payload_length);
+    return header;
+}
+
+// Returns a whole message: the header, with its lengths
+// filled in, followed by the path and payload
+std::string encode_message(Header header, const std::string& path, const std::string& payload){
+    header.path_length    = path.size();
+    header.payload_length = payload.size();
+    return encode_header(header) + path + payload;
+}
+
+// Returns the header of a response to the input request,
+// for a payload of payload_length bytes
+Header response_header(const Header& request, uint8_t status, uint64_t payload_length){
+    Header header;
+    header.opcode         = request.opcode;
+    header.status         = status;
+    header.request_id     = request.request_id;
+    header.payload_length = payload_length;
+    return header;
+}
+
+// Returns the codec a frame's payload is compressed with
+uint8_t frame_codec(const Header& header){
+    return header.flags >> CODEC_SHIFT;
+}
+
+// Marks a frame's payload as compressed with codec
+void set_frame_codec(Header& header, uint8_t codec){
+    header.flags = (header.flags & ((1 << CODEC_SHIFT) - 1)) | (codec << CODEC_SHIFT);
+}
+
+// Returns the payload of a BATCH running opcode over paths
+std::string encode_batch(uint8_t opcode, const std::vector<std::string>& paths){
+    std::string payload(1, (char) opcode);
+    for(const std::string& path : paths){
+        uint32_t length = htonl(path.size());
+        payload.append((char *) &length, 4);
+        payload += path;
+    }
+    return payload;
+}
+
+// Splits the payload of a BATCH into its opcode and paths.
+// Returns false if the payload is malformed.
+bool decode_batch(const std::string& payload, uint8_t& opcode, std::vector<std::string>& paths){
+    if( payload.empty() ){
+        return false;
+    }
+    opcode = payload[0];
+    size_t offset = 1;
+    while( offset < payload.size() ){
+        uint32_t length;
+        if( payload.size() - offset < 4 ){
+            return false;
+        }
+        std::memcpy(&length, &payload[offset], 4);
+        length  = ntohl(length);
+        offset += 4;
+        if( payload.size() - offset < length ){
+            return false;
+        }
+        paths.push_back(payload.substr(offset, length));
+        offset += length;
+    }
+    return true;
+}
+
+// Returns the metadata encoded for the wire
+std::string encode_metadata(const Metadata& metadata){
+    uint64_t size  = htobe64(metadata.size);
+    uint64_t mtime = htobe64((uint64_t) metadata.mtime_ns);
+    std::string bytes((char *) &size, 8);
+    bytes.append((char *) &mtime, 8);
+    return bytes;
+}
+
+// Returns the metadata held in the first METADATA_SIZE
+// bytes of the input
+Metadata decode_metadata(const char *bytes){
+    Metadata metadata;
+    uint64_t mtime;
+    std::memcpy(&metadata.size, bytes,     8);
+    std::memcpy(&mtime,         bytes + 8, 8);
+    metadata.size     = be64toh(metadata.size);
+    metadata.mtime_ns = (int64_t) be64toh(mtime);
+    return metadata;
+}
+
+// Returns the range encoded for the wire
+std::string encode_range(const Range& range){
+    uint64_t offset = htobe64(range.offset);
+    uint64_t length = htobe64(range.length);
+    std::string bytes((char *) &offset, 8);
+    bytes.append((char *) &length, 8);
+    return bytes;
+}
+
+// Returns the range held in the first RANGE_SIZE bytes of
+// the input
+Range decode_range(const char *bytes){
+    Range range;
+    std::memcpy(&range.offset, bytes,     8);
+    std::memcpy(&range.length, bytes + 8, 8);
+    range.offset = be64toh(range.offset);
+    range.length = be64toh(range.length);
+    return range;
+}
+
+// Returns the range cut to a file of file_size bytes, as a
+// LOAD of it is served
+Range clamp_range(Range range, uint64_t file_size){
+    range.offset = std::min(range.offset, file_size);
+    range.length = std::min(range.length, file_size - range.offset);
+    return range;
+}
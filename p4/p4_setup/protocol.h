@@ -0,0 +1,177 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+///////////////////////////////////////////////////////////
+// The p4 wire protocol. Every message, either way, is a
+// fixed header followed by a path and a payload:
+//   version   1 byte     request id      4 bytes
+//   opcode    1 byte     path length     4 bytes
+//   flags     1 byte     payload length  8 bytes
+//   status    1 byte
+// with multi-byte fields in network byte order.
+//
+// A connection opens with a HELLO each way and then
+// carries any number of requests. The client's HELLO may
+// offer compression codecs as its payload, one byte each
+// in order of preference; the server's names the one it
+// picked, if any, as a single byte. Then the payloads of
+// LOAD responses and DATA messages may be compressed with
+// it, frame by frame, which the codec in the upper bits
+// of the flags says. For a LOAD response, only the bytes
+// after the metadata are compressed. A compressed DATA
+// message expands to at most MAX_DATA_SIZE bytes.
+// Requests may be sent without waiting for earlier
+// replies, and each response carries the id of the
+// request it answers, in whatever order they finish. A
+// STORE is followed directly by DATA messages with the
+// contents, the last flagged FIN.
+//
+// A CHECK that finds its file answers with the file's
+// metadata as the payload: its size and modification time
+// in nanoseconds since the epoch, 8 bytes each.
+//
+// A LOAD may give a byte range as its payload: an offset
+// and a length, 8 bytes each, with the length cut to the
+// end of the file. Without one it loads the whole file.
+// Its response's payload is the file's metadata followed
+// by the bytes of the range, so the size of the whole file
+// is known before any of it arrives, and a client loading
+// a file in pieces can tell if it changed in between.
+//
+// A BATCH runs one CHECK or DELETE over many paths. Its
+// payload is that opcode (1 byte) followed by the paths,
+// each as a 4-byte length and the path itself. The
+// response's payload has a record per path, in order: a
+// status byte, followed for CHECKs by the metadata (zero
+// if the file was not found).
+//
+// A STATS takes no path or payload, and is answered with
+// the server's counters as text, one per line.
+///////////////////////////////////////////////////////////
+
+const uint8_t PROTOCOL_VERSION = 1;
+const size_t  HEADER_SIZE      = 20;
+
+enum Opcode : uint8_t {
+    OP_HELLO  = 1,
+    OP_CHECK  = 2,
+    OP_LOAD   = 3,
+    OP_STORE  = 4,
+    OP_DELETE = 5,
+    OP_DATA   = 6,
+    OP_BATCH  = 7,
+    OP_STATS  = 8,
+};
+
+// Responses only
+enum Status : uint8_t {
+    STATUS_OK        = 0,
+    STATUS_NOT_FOUND = 1,
+    STATUS_FAILED    = 2,
+};
+
+// Marks the last DATA message of an upload
+const uint8_t FLAG_FIN = 1;
+
+// Ways a payload can be compressed. Ids are never reused.
+enum Codec : uint8_t {
+    CODEC_NONE = 0,
+    CODEC_RLE  = 1,    // the run-length encoding of p1's mzip
+};
+
+// The codec of a frame's payload is kept in the upper
+// bits of its flags
+const int CODEC_SHIFT = 4;
+
+// The most a DATA message carries, before compression
+const size_t MAX_DATA_SIZE = 64 * 1024;
+
+// By default, the most a message that is read whole into
+// memory may carry, path and payload together. A server
+// refuses larger requests with STATUS_FAILED. DATA
+// messages and the contents of LOAD responses are streamed
+// instead, and may be larger.
+const uint64_t MAX_FRAME_SIZE = 16 << 20;
+
+struct Header {
+    uint8_t  version        = PROTOCOL_VERSION;
+    uint8_t  opcode         = 0;
+    uint8_t  flags          = 0;
+    uint8_t  status         = STATUS_OK;
+    uint32_t request_id     = 0;
+    uint32_t path_length    = 0;
+    uint64_t payload_length = 0;
+};
+
+// What a CHECK reports about a file
+struct Metadata {
+    uint64_t size     = 0;
+    int64_t  mtime_ns = 0;
+};
+
+const size_t METADATA_SIZE = 16;
+
+// The part of a file a LOAD asks for
+struct Range {
+    uint64_t offset = 0;
+    uint64_t length = UINT64_MAX;
+};
+
+const size_t RANGE_SIZE = 16;
+
+// A request as read off the wire
+struct Request {
+    Header      header;
+    std::string path;
+    std::string payload;
+    uint8_t     codec = CODEC_NONE;   // what the connection's HELLO settled on
+};
+
+// Returns the header encoded for the wire
+std::string encode_header(const Header& header);
+
+// Returns the header held in the first HEADER_SIZE bytes
+// of the input
+Header decode_header(const char *bytes);
+
+// Returns a whole message: the header, with its lengths
+// filled in, followed by the path and payload
+std::string encode_message(Header header, const std::string& path, const std::string& payload);
+
+// Returns the header of a response to the input request,
+// for a payload of payload_length bytes
+Header response_header(const Header& request, uint8_t status, uint64_t payload_length);
+
+// Returns the codec a frame's payload is compressed with
+uint8_t frame_codec(const Header& header);
+
+// Marks a frame's payload as compressed with codec
+void set_frame_codec(Header& header, uint8_t codec);
+
+// Returns the payload of a BATCH running opcode over paths
+std::string encode_batch(uint8_t opcode, const std::vector<std::string>& paths);
+
+// Splits the payload of a BATCH into its opcode and paths.
+// Returns false if the payload is malformed.
+bool decode_batch(const std::string& payload, uint8_t& opcode, std::vector<std::string>& paths);
+
+// Returns the metadata encoded for the wire
+std::string encode_metadata(const Metadata& metadata);
+
+// Returns the metadata held in the first METADATA_SIZE
+// bytes of the input
+Metadata decode_metadata(const char *bytes);
+
+// Returns the range encoded for the wire
+std::string encode_range(const Range& range);
+
+// Returns the range held in the first RANGE_SIZE bytes of
+// the input
+Range decode_range(const char *bytes);
+
+// Returns the range cut to a file of file_size bytes, as a
+// LOAD of it is served
+Range clamp_range(Range range, uint64_t file_size);
@@ -0,0 +1,614 @@
+#include "reactor.h"
+#include "compression.h"
+#include <iostream>
+#include <stdexcept>
+#include <cerrno>
+#include <algorithm>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// epoll data for the listening socket and the eventfd;
+// connections are identified by their (nonzero) ids
+static const uint64_t LISTEN_ID = 0;
+static const uint64_t WAKE_ID   = UINT64_MAX;
+
+// Requests a connection may have with workers at once.
+// Past this, reading stops until replies go out, so a
+// client pipelining faster than it reads replies can't
+// pile up work without bound.
+static const int MAX_IN_FLIGHT = 64;
+
+// Bytes read at a time when a file cannot be sent with
+// sendfile, and when an upload is written to its file
+static const size_t CHUNK_SIZE = 64 * 1024;
+
+// Bytes of free frame buffers each loop keeps for reuse
+static const size_t POOLED_BYTES = 16 << 20;
+
+// Accepts every pending connection
+void Reactor::accept_all(){
+    while( true ){
+        int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if( fd < 0 ){
+            // EAGAIN means the backlog is drained. Anything else
+            // is one client's problem, and is left for the next
+            // round.
+            return;
+        }
+        // Replies are sent as soon as they are ready, so a
+        // short one shouldn't wait on Nagle for the last one to
+        // be ACKed
+        int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+        Connection *connection = new Connection();
+        connection->id    = next_id++;
+        connection->fd    = fd;
+        connection->state = Connection::READING_HEADER;
+        connection->codec = CODEC_NONE;
+        connections[connection->id] = connection;
+        stats.connection_opened();
+
+        // Edge-triggered, so each event must be drained, but a
+        // connection is never woken for data it already knows
+        // about
+        epoll_event event;
+        event.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        event.data.u64 = connection->id;
+        if( epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0 ){
+            close_connection(connection);
+        }
+    }
+}
+
+// Writes all of data to fd, looping over short writes.
+// Returns false on error.
+static bool write_all(int fd, const char *data, size_t length){
+    while( length > 0 ){
+        ssize_t written = write(fd, data, length);
+        if( written < 0 ){
+            if( errno == EINTR ){
+                continue;
+            }
+            return false;
+        }
+        data   += written;
+        length -= written;
+    }
+    return true;
+}
+
+// Reads whatever has arrived on a connection, handing each
+// request to a worker once it is complete, and writing
+// upload data to its file
+void Reactor::read_ready(Connection *connection){
+    while( true ){
+        char  *target;
+        size_t wanted;
+        switch( connection->state ){
+            case Connection::READING_HEADER:
+                if( connection->in_flight >= MAX_IN_FLIGHT ){
+                    // Picked up again as replies go out
+                    return;
+                }
+                // fall through
+            case Connection::UPLOAD_HEADER:
+                target = connection->header + connection->received;
+                wanted = HEADER_SIZE - connection->received;
+                break;
+            case Connection::READING_BODY:
+                target = connection->body.data() + connection->received;
+                wanted = connection->body.size() - connection->received;
+                break;
+            case Connection::UPLOAD_BODY:
+                if( frame_codec(connection->current) != CODEC_NONE ){
+                    // A compressed message is small, and is read
+                    // whole before it is expanded
+                    target = connection->upload_buffer.data() + connection->received;
+                    wanted = connection->upload_buffer.size() - connection->received;
+                    break;
+                }
+                // Data only passes through this buffer, however
+                // large the message
+                connection->upload_buffer.resize(std::min(connection->current.payload_length - connection->received,
+                                                          (uint64_t) CHUNK_SIZE));
+                target = connection->upload_buffer.data();
+                wanted = connection->upload_buffer.size();
+                break;
+            default:
+                // Waiting on a worker, or done reading
+                return;
+        }
+
+        ssize_t received = (wanted == 0) ? 0 : recv(connection->fd, target, wanted, 0);
+        if( received < 0 ){
+            if( errno == EAGAIN || errno == EWOULDBLOCK ){
+                return;
+            }
+            if( errno == EINTR ){
+                continue;
+            }
+        }
+        if( received <= 0 && wanted > 0 ){
+            if( received == 0 && connection->state == Connection::READING_HEADER && connection->received == 0 ){
+                // The client is done sending, and is still owed
+                // the replies to what it sent
+                drain(connection);
+                return;
+            }
+            // The client left partway through a message
+            close_connection(connection);
+            return;
+        }
+        connection->received += received;
+        stats.add_bytes_in(received);
+
+        switch( connection->state ){
+            case Connection::READING_HEADER:
+                if( connection->received == HEADER_SIZE ){
+                    connection->current = decode_header(connection->header);
+                    if( connection->current.version != PROTOCOL_VERSION ){
+                        // Nothing it sends can be understood
+                        close_connection(connection);
+                        return;
+                    }
+                    // A frame is held whole until it is handled, so
+                    // its size is checked before anything is
+                    // allocated for it
+                    if( connection->current.payload_length > max_frame ||
+                        connection->current.path_length > max_frame - connection->current.payload_length ){
+                        reject(connection);
+                        return;
+                    }
+                    connection->body = frames.acquire(connection->current.path_length +
+                                                      connection->current.payload_length);
+                    connection->received = 0;
+                    connection->state    = Connection::READING_BODY;
+                }
+                break;
+            case Connection::READING_BODY:
+                if( connection->received == connection->body.size() ){
+                    connection->received = 0;
+                    connection->state    = Connection::READING_HEADER;
+                    start_request(connection);
+                }
+                break;
+            case Connection::UPLOAD_HEADER:
+                if( connection->received == HEADER_SIZE ){
+                    connection->current = decode_header(connection->header);
+                    // A STORE's contents must follow it directly
+                    if( connection->current.version != PROTOCOL_VERSION || connection->current.opcode != OP_DATA ||
+                        connection->current.request_id != connection->uploading.request_id ||
+                        connection->current.path_length != 0 ||
+                        (frame_codec(connection->current) != CODEC_NONE &&
+                         connection->current.payload_length > MAX_DATA_SIZE) ){
+                        close_connection(connection);
+                        return;
+                    }
+                    if( frame_codec(connection->current) != CODEC_NONE ){
+                        connection->upload_buffer.resize(connection->current.payload_length);
+                    }
+                    connection->received = 0;
+                    connection->state    = Connection::UPLOAD_BODY;
+                }
+                break;
+            case Connection::UPLOAD_BODY:
+                // After a failed write the rest of the upload is
+                // read and dropped, so the reply still gets through.
+                // Data that doesn't expand properly fails it too.
+                if( frame_codec(connection->current) == CODEC_NONE ){
+                    if( !connection->upload_failed && !write_all(connection->upload.upload_fd, target, received) ){
+                        connection->upload_failed = true;
+                    }
+                } else if( connection->received == connection->current.payload_length && !connection->upload_failed ){
+                    std::string expanded;
+                    if( !decompress(frame_codec(connection->current), connection->upload_buffer.data(),
+                                    connection->upload_buffer.size(), expanded, MAX_DATA_SIZE) ||
+                        !write_all(connection->upload.upload_fd, expanded.data(), expanded.size()) ){
+                        connection->upload_failed = true;
+                    }
+                }
+                if( connection->received == connection->current.payload_length ){
+                    connection->received = 0;
+                    if( connection->current.flags & FLAG_FIN ){
+                        finish_upload(connection);
+                    } else {
+                        connection->state = Connection::UPLOAD_HEADER;
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// Hands the request just read on a connection to a worker
+void Reactor::start_request(Connection *connection){
+    // The payload keeps the frame's buffer, and the worker
+    // hands it back to the pool once the request is done
+    std::shared_ptr<Request> request = std::make_shared<Request>();
+    request->header  = connection->current;
+    request->path    = connection->body.substr(0, request->header.path_length);
+    request->payload = std::move(connection->body);
+    request->payload.erase(0, request->header.path_length);
+    connection->body.clear();
+
+    // The HELLO settles the codec for the rest of the
+    // connection's replies
+    if( request->header.opcode == OP_HELLO ){
+        connection->codec = choose_codec(request->payload);
+    }
+    request->codec = connection->codec;
+
+    connection->in_flight++;
+    auto now = std::chrono::steady_clock::now();
+    if( request->header.opcode == OP_STORE ){
+        // The contents that follow are read once a worker has
+        // somewhere to put them
+        connection->uploading      = request->header;
+        connection->upload_started = now;
+        connection->state          = Connection::STARTING_UPLOAD;
+    }
+    submit({ connection->id, request->header, now, [handler = handler, &frames = frames, request]{
+        Reply reply = handler(*request);
+        frames.release(std::move(request->payload));
+        return reply;
+    } });
+}
+
+// Answers the request whose header was just read with
+// STATUS_FAILED, because its frame is over max_frame. What
+// follows it can't be found without reading it, so nothing
+// more is read from the connection.
+void Reactor::reject(Connection *connection){
+    Reply reply;
+    reply.head = encode_header(response_header(connection->current, STATUS_FAILED, 0));
+    stats.record_request(connection->current.opcode, STATUS_FAILED, std::chrono::nanoseconds(0));
+    connection->outgoing.push_back(std::move(reply));
+    connection->state = Connection::DRAINING;
+    write_ready(connection);
+}
+
+// Hands a finished upload to a worker for its reply
+void Reactor::finish_upload(Connection *connection){
+    bool complete = !connection->upload_failed;
+    submit({ connection->id, connection->uploading, connection->upload_started,
+             [finish = std::move(connection->upload.finish), complete]{
+        return finish(complete);
+    } });
+    connection->upload = Reply();
+    connection->upload_buffer.clear();
+    connection->state  = Connection::READING_HEADER;
+}
+
+// Sends as many queued replies as the socket takes
+void Reactor::write_ready(Connection *connection){
+    while( !connection->outgoing.empty() ){
+        const Reply& reply = connection->outgoing.front();
+        size_t body_size = reply.body ? reply.body->size() : 0;
+        while( connection->sent < reply.head.size() + body_size ){
+            // The head and body go out together, whatever is left
+            // of each
+            iovec parts[2];
+            int   count = 0;
+            if( connection->sent < reply.head.size() ){
+                parts[count].iov_base = (void *) (reply.head.data() + connection->sent);
+                parts[count].iov_len  = reply.head.size() - connection->sent;
+                count++;
+            }
+            if( body_size > 0 ){
+                size_t body_sent = connection->sent - std::min(connection->sent, reply.head.size());
+                parts[count].iov_base = (void *) (reply.body->data() + body_sent);
+                parts[count].iov_len  = body_size - body_sent;
+                count++;
+            }
+            msghdr message = {};
+            message.msg_iov    = parts;
+            message.msg_iovlen = count;
+            ssize_t sent = sendmsg(connection->fd, &message, MSG_NOSIGNAL);
+            if( sent < 0 ){
+                if( errno == EAGAIN || errno == EWOULDBLOCK ){
+                    return;
+                }
+                if( errno == EINTR ){
+                    continue;
+                }
+                close_connection(connection);
+                return;
+            }
+            connection->sent += sent;
+            stats.add_bytes_out(sent);
+        }
+        int result = send_file(connection);
+        if( result == 0 ){
+            return;
+        }
+        if( result < 0 ){
+            // The reply can't be finished, and the client would
+            // misread whatever followed it
+            close_connection(connection);
+            return;
+        }
+        if( connection->outgoing.front().file_fd >= 0 ){
+            close(connection->outgoing.front().file_fd);
+        }
+        connection->outgoing.pop_front();
+        connection->sent       = 0;
+        connection->buffered   = false;
+        connection->chunk.clear();
+        connection->chunk_sent = 0;
+    }
+    if( connection->state == Connection::DRAINING && connection->in_flight == 0 ){
+        close_connection(connection);
+    }
+}
+
+int Reactor::send_file(Connection *connection){
+    Reply& reply = connection->outgoing.front();
+    while( reply.file_length > 0 || connection->chunk_sent < connection->chunk.size() ){
+        ssize_t sent;
+        if( !connection->buffered ){
+            sent = sendfile(connection->fd, reply.file_fd, &reply.file_offset, reply.file_length);
+            if( sent < 0 && (errno == EINVAL || errno == ENOSYS) ){
+                // Not every file can be sent this way
+                connection->buffered = true;
+                continue;
+            }
+            if( sent > 0 ){
+                reply.file_length -= sent;
+            }
+        } else {
+            if( connection->chunk_sent == connection->chunk.size() ){
+                connection->chunk.resize(std::min(reply.file_length, CHUNK_SIZE));
+                ssize_t got = pread(reply.file_fd, connection->chunk.data(), connection->chunk.size(),
+                                    reply.file_offset);
+                if( got <= 0 ){
+                    return -1;
+                }
+                connection->chunk.resize(got);
+                connection->chunk_sent = 0;
+                reply.file_offset += got;
+                reply.file_length -= got;
+            }
+            sent = send(connection->fd, connection->chunk.data() + connection->chunk_sent,
+                        connection->chunk.size() - connection->chunk_sent, MSG_NOSIGNAL);
+            if( sent > 0 ){
+                connection->chunk_sent += sent;
+            }
+        }
+        if( sent > 0 ){
+            stats.add_bytes_out(sent);
+        }
+        if( sent < 0 ){
+            if( errno == EAGAIN || errno == EWOULDBLOCK ){
+                return 0;
+            }
+            if( errno == EINTR ){
+                continue;
+            }
+            return -1;
+        }
+        if( sent == 0 ){
+            // The file shrank after its size was sent; the client
+            // can tell from the short body
+            return -1;
+        }
+    }
+    return 1;
+}
+
+// Stops reading from a connection, closing it once
+// everything it asked for has been answered
+void Reactor::drain(Connection *connection){
+    connection->state = Connection::DRAINING;
+    if( connection->in_flight == 0 && connection->outgoing.empty() ){
+        close_connection(connection);
+    }
+}
+
+// Hands a job to a worker, or parks it in 'waiting' if the
+// pool's queue is full
+void Reactor::submit(Job job){
+    if( !dispatch(job) ){
+        waiting.push_back(std::move(job));
+    }
+}
+
+// Hands a job to a worker.
+// Returns false if the pool's queue is full.
+bool Reactor::dispatch(const Job& job){
+    return pool.try_submit([this, job]{
+        Reply reply;
+        try {
+            reply = job.run();
+        } catch (std::exception& e) {
+            std::cout << "Request failed: " << e.what() << "\n";
+            reply = Reply();
+            reply.head = encode_header(response_header(job.request, STATUS_FAILED, 0));
+        }
+        // A STORE is only done once its upload is
+        if( !reply.finish ){
+            uint8_t status = (reply.head.size() >= HEADER_SIZE) ? decode_header(reply.head.data()).status
+                                                                : STATUS_FAILED;
+            stats.record_request(job.request.opcode, status, std::chrono::steady_clock::now() - job.started);
+        }
+        {
+            std::lock_guard lock(completions_mut);
+            completions.push_back({ job.id, job.request, std::move(reply) });
+        }
+        uint64_t one = 1;
+        write(wake_fd, &one, sizeof(one));
+    });
+}
+
+// Picks up the replies posted by workers
+void Reactor::collect_completions(){
+    uint64_t count;
+    read(wake_fd, &count, sizeof(count));
+
+    std::vector<Completion> finished;
+    {
+        std::lock_guard lock(completions_mut);
+        finished.swap(completions);
+    }
+    for(Completion& completion : finished){
+        auto found = connections.find(completion.id);
+        if( found == connections.end() ){
+            // The client is already gone
+            if( completion.reply.file_fd >= 0 ){
+                close(completion.reply.file_fd);
+            }
+            if( completion.reply.finish ){
+                completion.reply.finish(false);
+            }
+            continue;
+        }
+        Connection *connection = found->second;
+        if( completion.reply.finish ){
+            // A STORE is ready for its contents. They have likely
+            // arrived already, and an edge-triggered loop won't
+            // hear about them again.
+            connection->upload        = std::move(completion.reply);
+            connection->upload_failed = (connection->upload.upload_fd < 0);
+            connection->received      = 0;
+            connection->state         = Connection::UPLOAD_HEADER;
+            read_ready(connection);
+            continue;
+        }
+        if( connection->state == Connection::STARTING_UPLOAD && completion.request.opcode == OP_STORE &&
+            completion.request.request_id == connection->uploading.request_id ){
+            // The STORE failed outright, and the contents that
+            // follow it can't be told apart from requests
+            connection->state = Connection::DRAINING;
+        }
+        bool was_full = (connection->in_flight == MAX_IN_FLIGHT);
+        connection->in_flight--;
+        connection->outgoing.push_back(std::move(completion.reply));
+        // The socket has probably been writable all along, and
+        // an edge-triggered loop won't hear about it again
+        write_ready(connection);
+        if( was_full && connections.count(completion.id) ){
+            read_ready(connection);
+        }
+    }
+
+    // Workers have freed up room in the queue
+    retry_waiting();
+}
+
+// Dispatches parked jobs until the pool's queue is full
+// again
+void Reactor::retry_waiting(){
+    while( !waiting.empty() && dispatch(waiting.front()) ){
+        waiting.pop_front();
+    }
+}
+
+// Stops watching a connection and closes it
+void Reactor::close_connection(Connection *connection){
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection->fd, nullptr);
+    close(connection->fd);
+    for(Reply& reply : connection->outgoing){
+        if( reply.file_fd >= 0 ){
+            close(reply.file_fd);
+        }
+    }
+    // An upload cut short is discarded
+    if( connection->upload.finish ){
+        connection->upload.finish(false);
+    }
+    connections.erase(connection->id);
+    delete connection;
+    stats.connection_closed();
+}
+
+void Reactor::run(){
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    while( true ){
+        // Parked jobs are retried now and then in case no
+        // worker of this loop finishes to trigger a retry
+        int timeout = waiting.empty() ? -1 : 10;
+        int count = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+        if( count < 0 && errno != EINTR ){
+            throw std::runtime_error("Waiting for events failed.");
+        }
+        if( count <= 0 ){
+            retry_waiting();
+        }
+        for(int i=0; i<count; i++){
+            uint64_t id = events[i].data.u64;
+            if( id == LISTEN_ID ){
+                accept_all();
+                continue;
+            }
+            if( id == WAKE_ID ){
+                collect_completions();
+                continue;
+            }
+            // A connection may have closed earlier in this batch
+            auto found = connections.find(id);
+            if( found == connections.end() ){
+                continue;
+            }
+            Connection *connection = found->second;
+            if( events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR) ){
+                read_ready(connection);
+                found = connections.find(id);
+                if( found == connections.end() ){
+                    continue;
+                }
+            }
+            if( events[i].events & EPOLLOUT ){
+                write_ready(connection);
+            }
+        }
+    }
+}
+
+// Constructor: Serves connections accepted on listen_fd,
+// which must already be listening
+Reactor::Reactor(int listen_fd, WorkerPool& pool, Handler handler, Stats& stats, uint64_t max_frame)
+    : listen_fd(listen_fd)
+    , pool(pool)
+    , handler(handler)
+    , stats(stats)
+    , max_frame(max_frame)
+    , frames(POOLED_BYTES)
+    , next_id(1)
+{
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd  = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if( epoll_fd < 0 || wake_fd < 0 ){
+        throw std::runtime_error("Could not set up the event loop.");
+    }
+    // The listening socket must not block once the backlog
+    // is drained
+    int flags = fcntl(listen_fd, F_GETFL);
+    fcntl(listen_fd, F_SETFL, flags | O_NONBLOCK);
+
+    epoll_event event;
+    event.events   = EPOLLIN | EPOLLET;
+    event.data.u64 = LISTEN_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.events   = EPOLLIN | EPOLLET;
+    event.data.u64 = WAKE_ID;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+}
+
+// Destructor: closes every connection
+Reactor::~Reactor(){
+    while( !connections.empty() ){
+        close_connection(connections.begin()->second);
+    }
+    close(wake_fd);
+    close(epoll_fd);
+}
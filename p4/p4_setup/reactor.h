@@ -0,0 +1,218 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+#include <sys/types.h>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include "worker_pool.h"
+#include "protocol.h"
+#include "stats.h"
+#include "frame_pool.h"
+
+// A reply to a request: bytes to send (starting with the
+// response header), then optionally a shared buffer, which
+// is sent without being copied, and a stretch of an open
+// file, which is sent straight from the page cache with
+// sendfile. The event loop closes the file once it is
+// sent.
+//
+// A STORE's reply instead sets finish and leaves head
+// empty. The event loop then writes the payloads of the
+// DATA messages that follow to upload_fd as they arrive
+// (or drops them if upload_fd is negative), and once the
+// one flagged FIN is in, has a worker run finish(true) for
+// the actual reply. If the client leaves partway or the
+// data could not be written, finish is given false
+// instead. finish owns upload_fd.
+struct Reply {
+    std::string                        head;
+    std::shared_ptr<const std::string> body;
+    int         file_fd     = -1;
+    off_t       file_offset = 0;
+    size_t      file_length = 0;
+
+    int                        upload_fd = -1;
+    std::function<Reply(bool)> finish;
+};
+
+///////////////////////////////////////////////////////////
+// An event loop serving the connections accepted on one
+// listening socket. Sockets are non-blocking and watched
+// with edge-triggered epoll. Each connection reads request
+// after request off its socket and hands each to a worker
+// as soon as it is complete, without waiting for earlier
+// ones to be answered; replies are queued and sent in the
+// order workers finish them. The reading side is a small
+// state machine:
+//   reading a header -> reading the path and payload ->
+//   (for a STORE, waiting on a worker -> reading DATA
+//   messages into a file) -> reading a header ...
+// Once the client stops sending, the connection is closed
+// after its last reply goes out. Requests are run on a
+// WorkerPool, since they block on the filesystem; workers
+// post finished replies back through an eventfd. Several
+// loops can share a port through SO_REUSEPORT, letting the
+// kernel spread connections across them.
+///////////////////////////////////////////////////////////
+class Reactor {
+
+    public:
+
+    // Returns the reply to a request, starting with its
+    // response header. Runs on a worker thread.
+    typedef Reply (*Handler)(const Request& request);
+
+    private:
+
+    struct Connection {
+        enum State { READING_HEADER, READING_BODY, STARTING_UPLOAD, UPLOAD_HEADER, UPLOAD_BODY, DRAINING };
+
+        uint64_t    id;
+        int         fd;
+        State       state;
+        char        header[HEADER_SIZE];
+        size_t      received;       // bytes of the header, body or payload read so far
+        Header      current;        // the header last read
+        std::string body;           // the path and payload of the request being read
+
+        // The STORE whose contents are being read, and what its
+        // worker set up for them
+        Header      uploading;
+        std::chrono::steady_clock::time_point upload_started;
+        Reply       upload;
+        bool        upload_failed;
+        std::string upload_buffer;
+
+        // The codec the client's HELLO settled on
+        uint8_t     codec;
+
+        // Requests handed to workers and not answered yet
+        int         in_flight;
+
+        // Replies ready to send, in the order they finished
+        std::deque<Reply> outgoing;
+        size_t      sent;           // bytes of the front reply's head and body sent so far
+
+        // Where sendfile cannot be used, the file is sent
+        // through this bounded buffer instead
+        bool        buffered;
+        std::string chunk;
+        size_t      chunk_sent;
+    };
+
+    // Work for a worker, answering the request with the
+    // given header on the connection with the input id. The
+    // request was read in full at 'started'.
+    struct Job {
+        uint64_t                              id;
+        Header                                request;
+        std::chrono::steady_clock::time_point started;
+        std::function<Reply()>                run;
+    };
+
+    // A reply finished by a worker, for the connection with
+    // the input id (which may have closed meanwhile)
+    struct Completion {
+        uint64_t id;
+        Header   request;
+        Reply    reply;
+    };
+
+    int         epoll_fd;
+    int         listen_fd;
+    int         wake_fd;
+    WorkerPool &pool;
+    Handler     handler;
+    Stats      &stats;
+
+    // The most a request frame (path and payload) may carry;
+    // larger ones are rejected without being read. DATA
+    // messages stream through a fixed buffer instead, and
+    // aren't limited.
+    uint64_t    max_frame;
+
+    // Buffers for request frames, shared by this loop's
+    // connections
+    FramePool   frames;
+
+    uint64_t                                  next_id;
+    std::unordered_map<uint64_t, Connection*> connections;
+
+    // Jobs that did not fit in the worker pool's queue,
+    // retried as workers finish
+    std::deque<Job> waiting;
+
+    // Filled by workers, emptied by the loop
+    std::mutex              completions_mut;
+    std::vector<Completion> completions;
+
+    // Accepts every pending connection
+    void accept_all();
+
+    // Reads whatever has arrived on a connection, handing
+    // each request to a worker once it is complete, and
+    // writing upload data to its file
+    void read_ready(Connection *connection);
+
+    // Hands the request just read on a connection to a worker
+    void start_request(Connection *connection);
+
+    // Answers the request whose header was just read with
+    // STATUS_FAILED, because its frame is over max_frame, and
+    // stops reading from the connection
+    void reject(Connection *connection);
+
+    // Hands a finished upload to a worker for its reply
+    void finish_upload(Connection *connection);
+
+    // Sends as many queued replies as the socket takes
+    void write_ready(Connection *connection);
+
+    // Sends as much of the front reply's file as the socket
+    // takes. Returns 1 once it is all sent, 0 if the socket
+    // is full and -1 on error.
+    int send_file(Connection *connection);
+
+    // Stops reading from a connection, closing it once
+    // everything it asked for has been answered
+    void drain(Connection *connection);
+
+    // Hands a job to a worker, or parks it in 'waiting' if
+    // the pool's queue is full
+    void submit(Job job);
+
+    // Hands a job to a worker.
+    // Returns false if the pool's queue is full.
+    bool dispatch(const Job& job);
+
+    // Picks up the replies posted by workers
+    void collect_completions();
+
+    // Dispatches parked jobs until the pool's queue is full
+    // again
+    void retry_waiting();
+
+    // Stops watching a connection and closes it
+    void close_connection(Connection *connection);
+
+    public:
+
+    // Runs the loop. Never returns.
+    void run();
+
+    // Constructor: Serves connections accepted on listen_fd,
+    // which must already be listening, counting what it does
+    // in stats. Request frames may carry up to max_frame
+    // bytes.
+    Reactor(int listen_fd, WorkerPool& pool, Handler handler, Stats& stats, uint64_t max_frame);
+
+    // Destructor: closes every connection
+    ~Reactor();
+
+};
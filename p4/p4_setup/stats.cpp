@@ -0,0 +1,180 @@
+#include "stats.h"
+#include "protocol.h"
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <algorithm>
+
+// Returns the bucket that holds value
+size_t Histogram::bucket_of(uint64_t value){
+    if( value < SUB_COUNT ){
+        return value;
+    }
+    // The top SUB_BITS + 1 bits pick the bucket: the highest
+    // set bit picks the power of two, and the rest the
+    // bucket within it
+    int shift = (63 - __builtin_clzll(value)) - SUB_BITS;
+    return SUB_COUNT + shift * SUB_COUNT + ((value >> shift) - SUB_COUNT);
+}
+
+// Returns the largest value that falls in bucket
+uint64_t Histogram::highest_in(size_t bucket){
+    if( bucket < SUB_COUNT ){
+        return bucket;
+    }
+    int      shift = (bucket - SUB_COUNT) / SUB_COUNT;
+    uint64_t base  = (SUB_COUNT + (bucket - SUB_COUNT) % SUB_COUNT) << shift;
+    return base + ((uint64_t) 1 << shift) - 1;
+}
+
+// Counts one value
+void Histogram::record(uint64_t value){
+    counts[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    uint64_t seen = max.load(std::memory_order_relaxed);
+    while( value > seen && !max.compare_exchange_weak(seen, value, std::memory_order_relaxed) ){
+    }
+}
+
+// Returns how many values were recorded
+uint64_t Histogram::get_count(){
+    return total.load(std::memory_order_relaxed);
+}
+
+// Returns the largest value recorded
+uint64_t Histogram::get_max(){
+    return max.load(std::memory_order_relaxed);
+}
+
+// Returns the value that fraction of the recorded values
+// are at or below, as the top of its bucket, or 0 if
+// nothing was recorded
+uint64_t Histogram::percentile(double fraction){
+    uint64_t count = get_count();
+    if( count == 0 ){
+        return 0;
+    }
+    // The rank of the value wanted, counting from 1
+    uint64_t rank = (uint64_t) (fraction * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for(size_t bucket = 0; bucket < BUCKETS; bucket++){
+        seen += counts[bucket].load(std::memory_order_relaxed);
+        if( seen >= rank ){
+            // Never past what was actually recorded
+            return std::min(highest_in(bucket), get_max());
+        }
+    }
+    return get_max();
+}
+
+// Constructor: Starts empty
+Histogram::Histogram()
+    : total(0)
+    , max(0)
+{
+    for(std::atomic<uint64_t>& count : counts){
+        count = 0;
+    }
+}
+
+// Names of the opcodes, as reports show them
+static const char *OPCODE_NAMES[] = { "OTHER", "HELLO", "CHECK", "LOAD", "STORE", "DELETE", "DATA", "BATCH",
+                                      "STATS" };
+
+// Counts a request that was answered with status after
+// latency
+void Stats::record_request(uint8_t opcode, uint8_t status, std::chrono::nanoseconds latency){
+    OpcodeStats& stats = opcodes[(opcode <= MAX_OPCODE) ? opcode : 0];
+    stats.requests.fetch_add(1, std::memory_order_relaxed);
+    if( status == STATUS_NOT_FOUND ){
+        stats.not_found.fetch_add(1, std::memory_order_relaxed);
+    } else if( status != STATUS_OK ){
+        stats.errors.fetch_add(1, std::memory_order_relaxed);
+    }
+    stats.latency_us.record(std::chrono::duration_cast<std::chrono::microseconds>(latency).count());
+}
+
+// Counts bytes read from clients
+void Stats::add_bytes_in(size_t bytes){
+    bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// Counts bytes written to clients
+void Stats::add_bytes_out(size_t bytes){
+    bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+// Counts a connection as it opens
+void Stats::connection_opened(){
+    connections_active.fetch_add(1, std::memory_order_relaxed);
+    connections_total.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Counts a connection as it closes
+void Stats::connection_closed(){
+    connections_active.fetch_sub(1, std::memory_order_relaxed);
+}
+
+// Returns the counters as text, one "name value" pair per
+// line, and a line per opcode seen
+std::string Stats::report(){
+    std::ostringstream out;
+    auto uptime = std::chrono::steady_clock::now() - started;
+    out << "uptime_s "           << std::chrono::duration_cast<std::chrono::seconds>(uptime).count() << "\n"
+        << "connections_active " << connections_active.load() << "\n"
+        << "connections_total "  << connections_total.load()  << "\n"
+        << "bytes_in "           << bytes_in.load()           << "\n"
+        << "bytes_out "          << bytes_out.load()          << "\n";
+    for(int opcode = 0; opcode <= MAX_OPCODE; opcode++){
+        OpcodeStats& stats = opcodes[opcode];
+        if( stats.requests.load() == 0 ){
+            continue;
+        }
+        out << "op " << OPCODE_NAMES[opcode]
+            << " requests "  << stats.requests.load()
+            << " not_found " << stats.not_found.load()
+            << " errors "    << stats.errors.load()
+            << " p50_us "    << stats.latency_us.percentile(0.5)
+            << " p99_us "    << stats.latency_us.percentile(0.99)
+            << " p999_us "   << stats.latency_us.percentile(0.999)
+            << " max_us "    << stats.latency_us.get_max() << "\n";
+    }
+    return out.str();
+}
+
+// Writes report() to path every interval, replacing the
+// file in one step. Never returns.
+void Stats::dump(std::string path, std::chrono::seconds interval){
+    std::string temp_path = path + ".tmp";
+    while( true ){
+        std::this_thread::sleep_for(interval);
+        {
+            std::ofstream file(temp_path, std::ios::trunc);
+            file << report();
+        }
+        std::rename(temp_path.c_str(), path.c_str());
+    }
+}
+
+// Starts a thread that writes report() to path every
+// interval_s seconds
+void Stats::dump_every(const std::string& path, int interval_s){
+    std::thread(&Stats::dump, this, path, std::chrono::seconds(interval_s)).detach();
+}
+
+// Constructor: Starts every counter at zero
+Stats::Stats()
+    : bytes_in(0)
+    , bytes_out(0)
+    , connections_active(0)
+    , connections_total(0)
+    , started(std::chrono::steady_clock::now())
+{
+    for(OpcodeStats& stats : opcodes){
+        stats.requests  = 0;
+        stats.not_found = 0;
+        stats.errors    = 0;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+///////////////////////////////////////////////////////////
+// A latency histogram in the style of HdrHistogram:
+// values below 32 get a bucket each, and every power of
+// two above that is split into 32 buckets, so any value is
+// recorded to within about 3% with a fixed, small table.
+// Recording is a single atomic increment, so any number of
+// threads can record at once.
+///////////////////////////////////////////////////////////
+class Histogram {
+
+    static const int    SUB_BITS = 5;
+    static const size_t SUB_COUNT = 1 << SUB_BITS;
+    static const size_t BUCKETS = SUB_COUNT + (64 - SUB_BITS) * SUB_COUNT;
+
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> max;
+
+    // Returns the bucket that holds value
+    static size_t bucket_of(uint64_t value);
+
+    // Returns the largest value that falls in bucket
+    static uint64_t highest_in(size_t bucket);
+
+    public:
+
+    // Counts one value
+    void record(uint64_t value);
+
+    // Returns how many values were recorded
+    uint64_t get_count();
+
+    // Returns the largest value recorded
+    uint64_t get_max();
+
+    // Returns the value that fraction of the recorded values
+    // are at or below, as the top of its bucket, or 0 if
+    // nothing was recorded
+    uint64_t percentile(double fraction);
+
+    // Constructor: Starts empty
+    Histogram();
+
+};
+
+///////////////////////////////////////////////////////////
+// What the server has done since it started: requests,
+// errors and latencies per opcode, bytes moved, and
+// connections. Event loops and workers update it as they
+// go, without locks; report() reads a snapshot that may be
+// a moment out of date between fields.
+//
+// Latency runs from a request being read in full to its
+// reply being ready to send, which takes in any wait for a
+// worker. For a STORE it runs to the end of its upload.
+///////////////////////////////////////////////////////////
+class Stats {
+
+    // Opcodes above this are counted together
+    static const int MAX_OPCODE = 8;
+
+    struct OpcodeStats {
+        std::atomic<uint64_t> requests;
+        std::atomic<uint64_t> not_found;
+        std::atomic<uint64_t> errors;
+        Histogram             latency_us;
+    };
+
+    OpcodeStats           opcodes[MAX_OPCODE + 1];
+    std::atomic<uint64_t> bytes_in;
+    std::atomic<uint64_t> bytes_out;
+    std::atomic<int64_t>  connections_active;
+    std::atomic<uint64_t> connections_total;
+    std::chrono::steady_clock::time_point started;
+
+    // Writes report() to path every interval, replacing the
+    // file in one step. Never returns.
+    void dump(std::string path, std::chrono::seconds interval);
+
+    public:
+
+    // Counts a request that was answered with status after
+    // latency
+    void record_request(uint8_t opcode, uint8_t status, std::chrono::nanoseconds latency);
+
+    // Counts bytes read from clients
+    void add_bytes_in(size_t bytes);
+
+    // Counts bytes written to clients
+    void add_bytes_out(size_t bytes);
+
+    // Counts a connection as it opens
+    void connection_opened();
+
+    // Counts a connection as it closes
+    void connection_closed();
+
+    // Returns the counters as text, one "name value" pair
+    // per line, and a line per opcode seen
+    std::string report();
+
+    // Starts a thread that writes report() to path every
+    // interval_s seconds
+    void dump_every(const std::string& path, int interval_s);
+
+    // Constructor: Starts every counter at zero
+    Stats();
+
+};
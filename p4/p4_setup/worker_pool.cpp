@@ -0,0 +1,68 @@
+#include "worker_pool.h"
+
+// Body of each worker thread
+void WorkerPool::work(){
+    while( true ){
+        Task task;
+        {
+            std::unique_lock lock(mut);
+            not_empty.wait(lock, [this]{ return stopping || !queue.empty(); });
+            if( queue.empty() ){
+                return;
+            }
+            task = std::move(queue.front());
+            queue.pop_front();
+        }
+        task();
+    }
+}
+
+// Queues a task if there is room for it.
+// Returns false if the queue is full.
+bool WorkerPool::try_submit(Task task){
+    {
+        std::lock_guard lock(mut);
+        if( queue.size() >= capacity ){
+            return false;
+        }
+        queue.push_back(std::move(task));
+    }
+    not_empty.notify_one();
+    return true;
+}
+
+// Returns the number of worker threads
+int WorkerPool::get_threads(){
+    return workers.size();
+}
+
+// Constructor: Starts the worker threads. Zero threads
+// means one per hardware thread.
+// Precondition: capacity must be positive
+WorkerPool::WorkerPool(int threads, size_t capacity)
+    : capacity(capacity)
+    , stopping(false)
+{
+    if( threads <= 0 ){
+        threads = std::thread::hardware_concurrency();
+    }
+    if( threads <= 0 ){
+        threads = 1;
+    }
+    for(int i=0; i<threads; i++){
+        workers.push_back(std::thread(&WorkerPool::work, this));
+    }
+}
+
+// Destructor: runs the tasks already queued, then stops
+// and joins the workers
+WorkerPool::~WorkerPool(){
+    {
+        std::lock_guard lock(mut);
+        stopping = true;
+    }
+    not_empty.notify_all();
+    for(std::thread& worker : workers){
+        worker.join();
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <vector>
+
+///////////////////////////////////////////////////////////
+// A fixed set of threads running tasks from a bounded
+// queue. When the queue is full, try_submit refuses the
+// task rather than letting the queue grow without limit.
+// The server's event loops park refused requests in their
+// own waiting queue until a worker frees up, and stop
+// reading from a connection once it has MAX_IN_FLIGHT
+// requests outstanding, so a full pool pushes back on
+// clients through TCP.
+///////////////////////////////////////////////////////////
+class WorkerPool {
+
+    public:
+
+    typedef std::function<void()> Task;
+
+    private:
+
+    std::vector<std::thread> workers;
+    std::deque<Task>         queue;
+    size_t                   capacity;
+    bool                     stopping;
+    std::mutex               mut;
+    std::condition_variable  not_empty;
+
+    // Body of each worker thread
+    void work();
+
+    public:
+
+    // Queues a task if there is room for it.
+    // Returns false if the queue is full.
+    bool try_submit(Task task);
+
+    // Returns the number of worker threads
+    int get_threads();
+
+    // Constructor: Starts the worker threads. Zero threads
+    // means one per hardware thread.
+    // Precondition: capacity must be positive
+    WorkerPool(int threads, size_t capacity);
+
+    // Destructor: runs the tasks already queued, then stops
+    // and joins the workers
+    ~WorkerPool();
+
+};